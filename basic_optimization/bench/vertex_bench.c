@@ -0,0 +1,245 @@
+// Runs one qsort_large build repeatedly on one input and reports the median wall time with a 95%
+// confidence interval, the median user + sys time, hardware counters from perf_event_open when the machine
+// exposes them, and the change against a stored baseline
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <linux/perf_event.h>
+
+#define MAX_RUNS 1000
+#define COUNTERS 4
+#define NAME_LENGTH 64
+
+const char *counter_names[COUNTERS] = {"cycles", "instructions", "cache-misses", "branch-misses"};
+const unsigned long long counter_configs[COUNTERS] = {
+  PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+struct run_result {
+  double wall, cpu;
+  double counters[COUNTERS];
+  int counted[COUNTERS];
+};
+
+// Count one hardware event in the child and every thread it starts, from its exec onwards
+int open_counter(pid_t pid, unsigned long long config)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.disabled = 1;
+  attr.enable_on_exec = 1;
+  attr.inherit = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return syscall(SYS_perf_event_open, &attr, pid, -1, -1, PERF_FLAG_FD_CLOEXEC);
+}
+
+double seconds(const struct timeval *time)
+{
+  return time->tv_sec + time->tv_usec / 1e6;
+}
+
+// The child blocks on a pipe until its counters are open, then execs with stdout and stderr discarded
+int run_once(char **command, struct run_result *result)
+{
+  struct timespec start, end;
+  struct rusage usage;
+  unsigned long long reading[3];
+  int gate[2], counters[COUNTERS], status, i;
+  char go = 0;
+  pid_t child;
+
+  if (pipe(gate) != 0) {
+    perror("pipe");
+    return -1;
+  }
+  child = fork();
+  if (child < 0) {
+    perror("fork");
+    close(gate[0]);
+    close(gate[1]);
+    return -1;
+  }
+  if (child == 0) {
+    int null = open("/dev/null", O_WRONLY);
+    close(gate[1]);
+    if (read(gate[0], &go, 1) != 1)
+      _exit(127);
+    dup2(null, STDOUT_FILENO);
+    dup2(null, STDERR_FILENO);
+    execv(command[0], command);
+    _exit(127);
+  }
+  close(gate[0]);
+  for (i = 0; i < COUNTERS; i++)
+    counters[i] = open_counter(child, counter_configs[i]);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (write(gate[1], &go, 1) != 1)
+    perror("write");
+  close(gate[1]);
+  if (wait4(child, &status, 0, &usage) != child) {
+    perror("wait4");
+    return -1;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  result->wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  result->cpu = seconds(&usage.ru_utime) + seconds(&usage.ru_stime);
+  // Scale for multiplexing when the counters did not run the whole time
+  for (i = 0; i < COUNTERS; i++) {
+    result->counted[i] = 0;
+    if (counters[i] >= 0 && read(counters[i], reading, sizeof(reading)) == sizeof(reading) && reading[2] > 0) {
+      result->counters[i] = (double)reading[0] * reading[1] / reading[2];
+      result->counted[i] = 1;
+    }
+    if (counters[i] >= 0)
+      close(counters[i]);
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "ERROR: %s did not exit cleanly (status %d)\n", command[0], status);
+    return -1;
+  }
+  return 0;
+}
+
+int compare_doubles(const void *elem1, const void *elem2)
+{
+  double a = *(const double *)elem1, b = *(const double *)elem2;
+
+  return (a > b) - (a < b);
+}
+
+// Sorts values and returns the median, low and high get the distribution free 95% confidence
+// interval for the median from the binomial order statistics
+double median(double *values, int count, double *low, double *high)
+{
+  int lower = (int)floor((count - 1.96 * sqrt(count)) / 2);
+  int upper = (int)ceil(1 + (count + 1.96 * sqrt(count)) / 2);
+
+  qsort(values, count, sizeof(double), compare_doubles);
+  if (lower < 1)
+    lower = 1;
+  if (upper > count)
+    upper = count;
+  if (low != NULL)
+    *low = values[lower - 1];
+  if (high != NULL)
+    *high = values[upper - 1];
+  return count % 2 ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+// Compare against the baseline line with the same variant and input, written at the end of the line
+void compare_baseline(FILE *out, const char *path, const char *name, const char *input, double wall, double low, double high)
+{
+  char line[512], base_name[NAME_LENGTH], base_input[NAME_LENGTH];
+  double base_wall, base_low, base_high;
+  FILE *fp = fopen(path, "r");
+
+  if (fp == NULL) {
+    fprintf(out, "  no baseline\n");
+    return;
+  }
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "%63s %63s wall %lf s [%lf, %lf]", base_name, base_input, &base_wall, &base_low, &base_high) == 5 &&
+        strcmp(base_name, name) == 0 && strcmp(base_input, input) == 0) {
+      fprintf(out, "  %.2fx vs baseline, %s\n", base_wall / wall,
+             low > base_high ? "regression" : high < base_low ? "speedup" : "within noise");
+      fclose(fp);
+      return;
+    }
+  }
+  fprintf(out, "  no baseline\n");
+  fclose(fp);
+}
+
+void report(FILE *out, char **names, struct run_result *results, int runs, const char *baseline)
+{
+  double wall[MAX_RUNS], cpu[MAX_RUNS], values[MAX_RUNS], low, high, middle;
+  int i, counter, counted, missing;
+
+  for (i = 0; i < runs; i++) {
+    wall[i] = results[i].wall;
+    cpu[i] = results[i].cpu;
+  }
+  middle = median(wall, runs, &low, &high);
+  fprintf(out, "%-10s %-10s wall %.4f s [%.4f, %.4f]  user+sys %.4f s", names[0], names[1], middle, low, high,
+          median(cpu, runs, NULL, NULL));
+  for (counter = 0, missing = 0; counter < COUNTERS; counter++) {
+    for (i = 0, counted = 0; i < runs; i++)
+      if (results[i].counted[counter])
+        values[counted++] = results[i].counters[counter];
+    if (counted == runs)
+      fprintf(out, "  %s %.1fM", counter_names[counter], median(values, counted, NULL, NULL) / 1e6);
+    else
+      missing++;
+  }
+  // Machines without a hardware PMU, such as most VMs, get one note instead of a column per counter
+  if (missing == COUNTERS)
+    fprintf(out, "  counters n/a");
+  else if (missing > 0)
+    fprintf(out, "  %d counters n/a", missing);
+  if (baseline != NULL)
+    compare_baseline(out, baseline, names[0], names[1], middle, low, high);
+  else
+    fprintf(out, "\n");
+}
+
+int
+main(int argc, char *argv[]) {
+  struct run_result *results;
+  char *baseline = NULL, *output = NULL;
+  int runs = 11, warmup = 2, option, i;
+  FILE *fp;
+
+  // -n runs, -w warmup runs that are not measured, -b baseline file, -o results file to append to
+  // without the baseline comparison, so it can become the next baseline; options stop at the variant name
+  while ((option = getopt(argc, argv, "+n:w:b:o:")) != -1) {
+    if (option == 'n')
+      runs = atoi(optarg);
+    else if (option == 'w')
+      warmup = atoi(optarg);
+    else if (option == 'b')
+      baseline = optarg;
+    else if (option == 'o')
+      output = optarg;
+    else
+      argc = 0;
+  }
+  if (argc - optind < 3 || runs < 1 || runs > MAX_RUNS || warmup < 0) {
+    fprintf(stderr,"Usage: vertex_bench [-n runs] [-w warmup] [-b baseline] [-o results] <variant> <input_label> <program> [args...]\n");
+    exit(-1);
+  }
+  results = malloc(runs * sizeof(struct run_result));
+  if (results == NULL) {
+    fprintf(stderr, "ERROR: failed to allocate results for %d runs\n", runs);
+    exit(-1);
+  }
+  for (i = 0; i < warmup + runs; i++)
+    if (run_once(&argv[optind + 2], &results[i < warmup ? 0 : i - warmup]) != 0)
+      exit(-1);
+
+  report(stdout, &argv[optind], results, runs, baseline);
+  if (output != NULL) {
+    fp = fopen(output, "a");
+    if (fp == NULL) {
+      perror(output);
+      exit(-1);
+    }
+    report(fp, &argv[optind], results, runs, NULL);
+    fclose(fp);
+  }
+  free(results);
+  return 0;
+}
@@ -0,0 +1,59 @@
+// Writes seeded random vertices for the qsort_large benchmarks, the same seed always gives the same file
+#include <stdlib.h>
+#include <stdio.h>
+
+#define BLOCK_SIZE (1 << 20)
+
+// Xorshift64* generator
+unsigned long long state;
+
+unsigned long long next_random(void)
+{
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  return state * 0x2545F4914F6CDD1DULL;
+}
+
+int
+main(int argc, char *argv[]) {
+  unsigned long long vertices, seed, range, i;
+  FILE *fp;
+  int axis;
+
+  if (argc != 5) {
+    fprintf(stderr,"Usage: vertex_gen <vertices> <seed> <range> <file>\n");
+    exit(-1);
+  }
+  vertices = strtoull(argv[1], NULL, 10);
+  seed = strtoull(argv[2], NULL, 10);
+  range = strtoull(argv[3], NULL, 10);
+  if (range > 2147483647ULL) {
+    fprintf(stderr,"ERROR: range must be at most 2147483647\n");
+    exit(-1);
+  }
+  fp = fopen(argv[4], "w");
+  if (fp == NULL) {
+    perror(argv[4]);
+    exit(-1);
+  }
+  setvbuf(fp, NULL, _IOFBF, BLOCK_SIZE);
+
+  // Seed through splitmix so small seeds still give good streams
+  state = seed + 0x9E3779B97F4A7C15ULL;
+  state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+  state ^= state >> 31;
+  if (state == 0)
+    state = 1;
+
+  // Each coordinate is uniform in [-range, range]
+  for (i = 0; i < vertices; i++)
+    for (axis = 0; axis < 3; axis++)
+      fprintf(fp, axis < 2 ? "%lld " : "%lld\n", (long long)(next_random() % (2 * range + 1)) - (long long)range);
+  if (fclose(fp) != 0) {
+    perror(argv[4]);
+    exit(-1);
+  }
+  return 0;
+}
@@ -0,0 +1,361 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "vertex_io.h"
+
+#define READ_CHUNK (1 << 20)
+
+// Parse a byte count with an optional K, M or G suffix, returns 0 on a bad value
+size_t parse_budget(const char *text)
+{
+  char *end;
+  unsigned long long value;
+  int shift = 0;
+
+  errno = 0;
+  value = strtoull(text, &end, 10);
+  if (end == text || text[0] == '-' || errno == ERANGE)
+    return 0;
+  switch (*end) {
+  case 'G': case 'g': shift = 30; end++; break;
+  case 'M': case 'm': shift = 20; end++; break;
+  case 'K': case 'k': shift = 10; end++; break;
+  }
+  if (*end != '\0' || value > (ULLONG_MAX >> shift) || (value << shift) > SIZE_MAX)
+    return 0;
+  return (size_t)(value << shift);
+}
+
+// Next size for a geometrically growing vertex store, capped by the memory budget (0 means no
+// budget). Returns 0 when the store cannot grow.
+size_t grow_capacity(size_t capacity, size_t vertex_bytes, size_t budget)
+{
+  size_t limit = budget ? budget / vertex_bytes : (size_t)-1 / vertex_bytes;
+  size_t next = capacity ? capacity * 2 : INITIAL_VERTICES;
+
+  if (next > limit || next < capacity)
+    next = limit;
+  if (next <= capacity) {
+    fprintf(stderr, "ERROR: more than %zu vertices do not fit in a memory budget of %zu bytes\n", capacity, budget);
+    return 0;
+  }
+  return next;
+}
+
+int check_budget(size_t count, size_t vertex_bytes, size_t budget)
+{
+  if (budget && count > budget / vertex_bytes) {
+    fprintf(stderr, "ERROR: %zu vertices do not fit in a memory budget of %zu bytes\n", count, budget);
+    return -1;
+  }
+  return 0;
+}
+
+// -m <bytes> is a hard limit on vertex storage, -w <file> converts the input to a binary vertex
+// file, -j <threads> sets the thread count and -b <file> writes the sorted vertices to a binary
+// vertex file. flags is the getopt string of the options a variant takes.
+void parse_options(int argc, char *argv[], const char *flags, const char *usage, struct vertex_options *options)
+{
+  char *end;
+  int option;
+
+  memset(options, 0, sizeof(*options));
+  options->threads = 1;
+  while ((option = getopt(argc, argv, flags)) != -1) {
+    if (option == 'm' && (options->budget = parse_budget(optarg)) == 0) {
+      fprintf(stderr,"ERROR: invalid memory budget: %s\n", optarg);
+      exit(-1);
+    }
+    else if (option == 'j') {
+      options->threads = (int)strtol(optarg, &end, 10);
+      if (end == optarg || *end != '\0' || options->threads < 1 || options->threads > MAX_THREADS) {
+        fprintf(stderr,"ERROR: thread count must be between 1 and %d: %s\n", MAX_THREADS, optarg);
+        exit(-1);
+      }
+    }
+    else if (option == 'w')
+      options->binary_path = optarg;
+    else if (option == 'b')
+      options->sorted_path = optarg;
+    else if (option == '?')
+      argc = 0;
+  }
+  if (argc - optind != 1) {
+    fprintf(stderr,"Usage: %s\n", usage);
+    exit(-1);
+  }
+  options->input_path = argv[optind];
+}
+
+// Map the input file, falling back to read() for pipes and other unmappable files
+static int open_input(const char *path, struct input_file *input)
+{
+  struct stat info;
+  size_t capacity = 0;
+  ssize_t got;
+  int fd = open(path, O_RDONLY);
+
+  memset(input, 0, sizeof(*input));
+  if (fd < 0) {
+    perror(path);
+    return -1;
+  }
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+    fprintf(stderr, "Reading %lld bytes from %s\n", (long long)info.st_size, path);
+    input->size = info.st_size;
+    if (input->size == 0) {
+      close(fd);
+      return 0;
+    }
+    input->data = mmap(NULL, input->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (input->data != MAP_FAILED) {
+      madvise(input->data, input->size, MADV_SEQUENTIAL);
+      input->mapped = 1;
+      close(fd);
+      return 0;
+    }
+    input->data = NULL;
+    input->size = 0;
+  }
+  do {
+    if (capacity - input->size < READ_CHUNK) {
+      char *grown = realloc(input->data, capacity + READ_CHUNK);
+      if (grown == NULL) {
+        fprintf(stderr, "ERROR: failed to buffer %s\n", path);
+        close(fd);
+        return -1;
+      }
+      input->data = grown;
+      capacity += READ_CHUNK;
+    }
+    got = read(fd, input->data + input->size, capacity - input->size);
+    if (got > 0)
+      input->size += got;
+  } while (got > 0);
+  close(fd);
+  if (got < 0) {
+    perror(path);
+    return -1;
+  }
+  return 0;
+}
+
+static void close_input(struct input_file *input)
+{
+  if (input->mapped)
+    munmap(input->data, input->size);
+  else
+    free(input->data);
+}
+
+// Opens a vertex file. A binary file is checked against its header and reader->count holds its
+// vertex count; text is parsed as next_vertex goes.
+int open_vertices(const char *path, struct vertex_reader *reader)
+{
+  uint64_t header_count;
+
+  memset(reader, 0, sizeof(*reader));
+  if (open_input(path, &reader->input) != 0)
+    return -1;
+  reader->path = path;
+  reader->p = reader->input.data;
+  reader->end = reader->input.data + reader->input.size;
+  reader->line = 1;
+  if (reader->input.size < BINARY_HEADER || memcmp(reader->input.data, BINARY_MAGIC, strlen(BINARY_MAGIC)) != 0)
+    return 0;
+
+  memcpy(&header_count, reader->input.data + strlen(BINARY_MAGIC), sizeof(header_count));
+  if ((reader->input.size - BINARY_HEADER) % (3 * sizeof(int32_t)) != 0 ||
+      (reader->input.size - BINARY_HEADER) / (3 * sizeof(int32_t)) != header_count) {
+    fprintf(stderr, "ERROR: %s: binary vertex file does not match its header\n", path);
+    close_input(&reader->input);
+    return -1;
+  }
+  reader->binary = 1;
+  reader->count = header_count;
+  return 0;
+}
+
+// Reads the next vertex into coordinate. Returns 1 for a vertex, 0 at the end of the input and
+// -1 after reporting a parse error.
+int next_vertex(struct vertex_reader *reader, int coordinate[3])
+{
+  const char *p = reader->p, *end = reader->end;
+  const char *error = NULL;
+  size_t line = reader->line, vertex_line = line;
+  int field = 0;
+
+  if (reader->binary) {
+    const int32_t *coordinates = (const int32_t *)(reader->input.data + BINARY_HEADER) + 3 * reader->next;
+
+    if (reader->next == reader->count)
+      return 0;
+    coordinate[0] = coordinates[0];
+    coordinate[1] = coordinates[1];
+    coordinate[2] = coordinates[2];
+    reader->next++;
+    return 1;
+  }
+
+  // Whitespace separated ints, three per vertex
+  while (field < 3) {
+    unsigned long long value = 0, limit = INT_MAX;
+    int negative = 0;
+
+    while (p < end && isspace((unsigned char)*p)) {
+      if (*p == '\n')
+        line++;
+      p++;
+    }
+    if (p == end)
+      break;
+    if (field == 0)
+      vertex_line = line;
+    if (*p == '-' || *p == '+') {
+      negative = (*p == '-');
+      limit += negative;
+      p++;
+    }
+    if (p == end || !isdigit((unsigned char)*p)) {
+      error = "expected an integer";
+      break;
+    }
+    // The limit check keeps the value exact, so it can never wrap past INT_MIN/INT_MAX
+    while (p < end && isdigit((unsigned char)*p)) {
+      value = value * 10 + (*p++ - '0');
+      if (value > limit)
+        break;
+    }
+    if (value > limit) {
+      error = "integer out of range";
+      break;
+    }
+    if (p < end && !isspace((unsigned char)*p)) {
+      error = "expected an integer";
+      break;
+    }
+    coordinate[field++] = negative ? (int)-(long long)value : (int)value;
+  }
+  reader->p = p;
+  reader->line = line;
+  if (error == NULL && field == 3)
+    return 1;
+  if (error == NULL && field == 0)
+    return 0;
+  if (error == NULL) {
+    error = "incomplete vertex at end of input";
+    line = vertex_line;
+  }
+  fprintf(stderr, "ERROR: %s:%zu: %s\n", reader->path, line, error);
+  return -1;
+}
+
+void close_vertices(struct vertex_reader *reader)
+{
+  close_input(&reader->input);
+}
+
+// Vertices live in a heap array of vertex_bytes elements that doubles as it fills
+static void *resize_vertices(void *array, size_t capacity, size_t vertex_bytes)
+{
+  void *resized = realloc(array, (capacity ? capacity : 1) * vertex_bytes);
+
+  if (resized == NULL) {
+    fprintf(stderr, "ERROR: failed to allocate %zu vertices\n", capacity);
+    free(array);
+  }
+  return resized;
+}
+
+// Reads a whole vertex file into an array of vertex_bytes elements, filled in by set. A binary
+// file gives its vertex count up front, text grows the array as it is parsed. On failure the
+// array is freed and *array is NULL.
+int load_vertices(const char *path, size_t vertex_bytes, size_t budget, set_vertex_fn set, void **array, size_t *count)
+{
+  struct vertex_reader reader;
+  size_t capacity = 0;
+  int coordinate[3], result;
+
+  *array = NULL;
+  *count = 0;
+  if (open_vertices(path, &reader) != 0)
+    return -1;
+  if (reader.binary) {
+    capacity = reader.count;
+    if (check_budget(capacity, vertex_bytes, budget) != 0 || (*array = resize_vertices(NULL, capacity, vertex_bytes)) == NULL) {
+      close_vertices(&reader);
+      return -1;
+    }
+  }
+  while ((result = next_vertex(&reader, coordinate)) > 0) {
+    if (*count == capacity) {
+      capacity = grow_capacity(capacity, vertex_bytes, budget);
+      if (capacity == 0 || (*array = resize_vertices(*array, capacity, vertex_bytes)) == NULL) {
+        result = -1;
+        break;
+      }
+    }
+    set((char *)*array + (*count)++ * vertex_bytes, coordinate[0], coordinate[1], coordinate[2]);
+  }
+  close_vertices(&reader);
+  if (result != 0) {
+    free(*array);
+    *array = NULL;
+  }
+  return result;
+}
+
+// Starts a binary vertex file of count vertices, so later runs can skip text parsing
+FILE *create_binary(const char *path, size_t count)
+{
+  FILE *fp = fopen(path, "wb");
+  uint64_t header_count = count;
+
+  if (fp == NULL) {
+    perror(path);
+    return NULL;
+  }
+  fwrite(BINARY_MAGIC, 1, strlen(BINARY_MAGIC), fp);
+  fwrite(&header_count, sizeof(header_count), 1, fp);
+  return fp;
+}
+
+void put_binary(FILE *fp, int x, int y, int z)
+{
+  int32_t coordinates[3] = {x, y, z};
+
+  fwrite(coordinates, sizeof(coordinates), 1, fp);
+}
+
+int finish_binary(FILE *fp, const char *path)
+{
+  if (ferror(fp) | fclose(fp)) {
+    perror(path);
+    return -1;
+  }
+  return 0;
+}
+
+// Writes count elements of vertex_bytes each as a binary vertex file, get gives their coordinates
+int save_vertices(const char *path, const void *array, size_t vertex_bytes, size_t count, get_vertex_fn get)
+{
+  FILE *fp = create_binary(path, count);
+  int coordinate[3];
+  size_t i;
+
+  if (fp == NULL)
+    return -1;
+  for (i = 0; i < count; i++) {
+    get((const char *)array + i * vertex_bytes, coordinate);
+    put_binary(fp, coordinate[0], coordinate[1], coordinate[2]);
+  }
+  return finish_binary(fp, path);
+}
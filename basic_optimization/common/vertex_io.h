@@ -0,0 +1,61 @@
+#ifndef VERTEX_IO_H
+#define VERTEX_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define INITIAL_VERTICES 4096
+#define MAX_THREADS 256
+// Binary vertex file: "VTX1", a 64-bit vertex count, then x, y, z as 32-bit ints per vertex
+#define BINARY_MAGIC "VTX1"
+#define BINARY_HEADER 12
+
+// Whole input file, mapped when possible and read into memory otherwise
+struct input_file {
+  char *data;
+  size_t size;
+  int mapped;
+};
+
+// Hands out the vertices of a text or binary vertex file one at a time
+struct vertex_reader {
+  struct input_file input;
+  const char *path;
+  int binary;
+  // Binary files: the vertex count from the header and the next vertex to read
+  size_t count, next;
+  // Text files: the parse position and its line number
+  const char *p, *end;
+  size_t line;
+};
+
+// Command line options shared by the qsort_large variants
+struct vertex_options {
+  size_t budget;
+  int threads;
+  char *binary_path;
+  char *sorted_path;
+  char *input_path;
+};
+
+// Fill in and read back one element of a caller defined vertex array
+typedef void (*set_vertex_fn)(void *vertex, int x, int y, int z);
+typedef void (*get_vertex_fn)(const void *vertex, int coordinate[3]);
+
+size_t parse_budget(const char *text);
+size_t grow_capacity(size_t capacity, size_t vertex_bytes, size_t budget);
+int check_budget(size_t count, size_t vertex_bytes, size_t budget);
+void parse_options(int argc, char *argv[], const char *flags, const char *usage, struct vertex_options *options);
+
+int open_vertices(const char *path, struct vertex_reader *reader);
+int next_vertex(struct vertex_reader *reader, int coordinate[3]);
+void close_vertices(struct vertex_reader *reader);
+int load_vertices(const char *path, size_t vertex_bytes, size_t budget, set_vertex_fn set, void **array, size_t *count);
+
+FILE *create_binary(const char *path, size_t count);
+void put_binary(FILE *fp, int x, int y, int z);
+int finish_binary(FILE *fp, const char *path);
+int save_vertices(const char *path, const void *array, size_t vertex_bytes, size_t count, get_vertex_fn get);
+
+#endif
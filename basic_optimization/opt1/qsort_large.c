@@ -1,9 +1,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include "vertex_io.h"
 
 #define UNLIMIT
-#define MAXARRAY 60000 /* this number, if too large, will cause a seg. fault!! */
 
 struct my3DVertexStruct {
   //betaylor changed comparison from distance (double) to squared distance (int) to reduce redundant & expensive computation
@@ -18,35 +18,51 @@ int compare(const void *elem1, const void *elem2)
   return (*((struct my3DVertexStruct *)elem1)).square_distance - (*((struct my3DVertexStruct *)elem2)).square_distance;;
 }
 
+void set_vertex(void *element, int x, int y, int z)
+{
+  struct my3DVertexStruct *vertex = element;
+
+  vertex->x = x;
+  vertex->y = y;
+  vertex->z = z;
+  //betaylor used squared distance
+  vertex->square_distance = x*x + y*y + z*z;
+}
+
+void get_vertex(const void *element, int coordinate[3])
+{
+  const struct my3DVertexStruct *vertex = element;
+
+  coordinate[0] = vertex->x;
+  coordinate[1] = vertex->y;
+  coordinate[2] = vertex->z;
+}
+
 
 int
 main(int argc, char *argv[]) {
-  struct my3DVertexStruct array[MAXARRAY];
-  FILE *fp;
-  int i,count=0;
-  int x, y, z;
+  struct my3DVertexStruct *array = NULL;
+  void *loaded;
+  struct vertex_options options;
+  size_t i,count=0;
   
-  if (argc<2) {
-    fprintf(stderr,"Usage: qsort_large <file>\n");
+  parse_options(argc, argv, "m:w:", "qsort_large [-m max_bytes] [-w binary_file] <file>", &options);
+  if (load_vertices(options.input_path, sizeof(struct my3DVertexStruct), options.budget, set_vertex, &loaded, &count) != 0)
     exit(-1);
+  array = loaded;
+  if (options.binary_path != NULL) {
+    if (save_vertices(options.binary_path, array, sizeof(struct my3DVertexStruct), count, get_vertex) != 0)
+      exit(-1);
+    fprintf(stderr, "Wrote %zu vertices to %s\n", count, options.binary_path);
+    free(array);
+    return 0;
   }
-  else {
-    fp = fopen(argv[1],"r");
-    
-    while((fscanf(fp, "%d", &x) == 1) && (fscanf(fp, "%d", &y) == 1) && (fscanf(fp, "%d", &z) == 1) &&  (count < MAXARRAY)) {
-	 array[count].x = x;
-	 array[count].y = y;
-	 array[count].z = z;
-	 //betaylor used squared distance
-	 array[count].square_distance = x*x + y*y + z*z;
-	 count++;
-    }
-  }
-  printf("\nSorting %d vectors based on distance from the origin.\n\n",count);
+  printf("\nSorting %zu vectors based on distance from the origin.\n\n",count);
   
   qsort(array,count,sizeof(struct my3DVertexStruct),compare);
 
   for(i=0;i<count;i++)
     printf("%d %d %d\n", array[i].x, array[i].y, array[i].z);
+  free(array);
   return 0;
 }
@@ -0,0 +1,470 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#include "vertex_io.h"
+
+#define UNLIMIT
+// The memory budget pays for the coordinates plus a sort entry and its scatter buffer per vertex
+#define VERTEX_BYTES (3 * sizeof(int) + 2 * sizeof(struct sort_entry))
+#define KEY_BYTES 8
+#define RADIX 256
+// Each output thread formats this many vertices per round before the blocks are written in order
+#define FORMAT_BLOCK 16384
+// Longest text line: three "-2147483648" with separators and a newline
+#define LINE_BYTES (3 * 12)
+// The gather jumps around the coordinate arrays, so fetch this many entries ahead
+#define PREFETCH_DISTANCE 16
+
+// Structure of arrays: coordinates stay where the parser put them and the sort only moves
+// (key, index) pairs, which are gathered back into coordinates when printing
+struct vertex_arrays {
+  int *x, *y, *z;
+  size_t count, capacity;
+};
+
+struct sort_entry {
+  // Squared distance as a 64-bit key, 3 * (2^31)^2 fits without overflow for any int coordinates
+  uint64_t square_distance;
+  size_t index;
+};
+
+void set_vertex(struct vertex_arrays *vertices, size_t i, int x, int y, int z)
+{
+  vertices->x[i] = x;
+  vertices->y[i] = y;
+  vertices->z[i] = z;
+}
+
+// Keys are computed by the sort threads rather than while parsing, so they are built in parallel
+void compute_keys_scalar(const struct vertex_arrays *vertices, struct sort_entry *entries, size_t begin, size_t end)
+{
+  size_t i;
+
+  for (i = begin; i < end; i++) {
+    entries[i].square_distance = (uint64_t)((int64_t)vertices->x[i]*vertices->x[i]) +
+      (uint64_t)((int64_t)vertices->y[i]*vertices->y[i]) + (uint64_t)((int64_t)vertices->z[i]*vertices->z[i]);
+    entries[i].index = i;
+  }
+}
+
+#if defined(__x86_64__)
+// Four vertices at a time: sign extend each coordinate to 64 bits, square with a widening
+// multiply, then interleave keys with their indices to store four whole sort entries
+__attribute__((target("avx2")))
+void compute_keys_avx2(const struct vertex_arrays *vertices, struct sort_entry *entries, size_t begin, size_t end)
+{
+  __m256i index = _mm256_set_epi64x(begin + 3, begin + 2, begin + 1, begin);
+  __m256i step = _mm256_set1_epi64x(4);
+  size_t i;
+
+  for (i = begin; i + 4 <= end; i += 4) {
+    __m256i x = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(vertices->x + i)));
+    __m256i y = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(vertices->y + i)));
+    __m256i z = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)(vertices->z + i)));
+    __m256i key = _mm256_add_epi64(_mm256_add_epi64(_mm256_mul_epi32(x, x), _mm256_mul_epi32(y, y)), _mm256_mul_epi32(z, z));
+    __m256i even = _mm256_unpacklo_epi64(key, index);
+    __m256i odd = _mm256_unpackhi_epi64(key, index);
+    _mm256_storeu_si256((__m256i *)&entries[i], _mm256_permute2x128_si256(even, odd, 0x20));
+    _mm256_storeu_si256((__m256i *)&entries[i + 2], _mm256_permute2x128_si256(even, odd, 0x31));
+    index = _mm256_add_epi64(index, step);
+  }
+  compute_keys_scalar(vertices, entries, i, end);
+}
+#endif
+
+void compute_keys(const struct vertex_arrays *vertices, struct sort_entry *entries, size_t begin, size_t end)
+{
+#if defined(__x86_64__)
+  if (sizeof(size_t) == sizeof(uint64_t) && __builtin_cpu_supports("avx2")) {
+    compute_keys_avx2(vertices, entries, begin, end);
+    return;
+  }
+#endif
+  compute_keys_scalar(vertices, entries, begin, end);
+}
+
+int resize_arrays(struct vertex_arrays *vertices, size_t capacity)
+{
+  int *x = realloc(vertices->x, (capacity ? capacity : 1) * sizeof(int));
+  int *y = x ? realloc(vertices->y, (capacity ? capacity : 1) * sizeof(int)) : NULL;
+  int *z = y ? realloc(vertices->z, (capacity ? capacity : 1) * sizeof(int)) : NULL;
+
+  if (x)
+    vertices->x = x;
+  if (y)
+    vertices->y = y;
+  if (z == NULL) {
+    fprintf(stderr, "ERROR: failed to allocate %zu vertices\n", capacity);
+    return -1;
+  }
+  vertices->z = z;
+  vertices->capacity = capacity;
+  return 0;
+}
+
+void free_arrays(struct vertex_arrays *vertices)
+{
+  free(vertices->x);
+  free(vertices->y);
+  free(vertices->z);
+}
+
+// The sort threads share one barrier that separates the counting, offset and scatter phases
+struct sort_shared {
+  const struct vertex_arrays *vertices;
+  struct sort_entry *entries, *buffer, *sorted;
+  size_t count;
+  int threads;
+  pthread_barrier_t barrier;
+  struct sort_job *jobs;
+  size_t totals[KEY_BYTES][RADIX];
+};
+
+// Each thread owns a contiguous slice of the entries and its own digit counts
+struct sort_job {
+  struct sort_shared *shared;
+  int id;
+  size_t begin, end;
+  size_t histogram[KEY_BYTES][RADIX];
+  size_t bucket[RADIX];
+};
+
+// LSD radix sort on the 64-bit key, one byte per pass. Every thread computes the keys of its
+// slice and counts its digits; offsets are laid out digit-major, thread-minor, so the scatter stays
+// stable and the result is the same for any thread count. Passes where every key shares the byte are skipped
+void *sort_thread(void *arg)
+{
+  struct sort_job *job = arg;
+  struct sort_shared *shared = job->shared;
+  struct sort_entry *from = shared->entries, *to = shared->buffer, *swap;
+  size_t i, offset, bucket_count;
+  int pass, digit, t, counted = 1;
+
+  compute_keys(shared->vertices, from, job->begin, job->end);
+  memset(job->histogram, 0, sizeof(job->histogram));
+  for (i = job->begin; i < job->end; i++)
+    for (pass = 0; pass < KEY_BYTES; pass++)
+      job->histogram[pass][(from[i].square_distance >> (8 * pass)) & (RADIX - 1)]++;
+  pthread_barrier_wait(&shared->barrier);
+  if (job->id == 0) {
+    memset(shared->totals, 0, sizeof(shared->totals));
+    for (t = 0; t < shared->threads; t++)
+      for (pass = 0; pass < KEY_BYTES; pass++)
+        for (digit = 0; digit < RADIX; digit++)
+          shared->totals[pass][digit] += shared->jobs[t].histogram[pass][digit];
+  }
+  pthread_barrier_wait(&shared->barrier);
+
+  for (pass = 0; pass < KEY_BYTES; pass++) {
+    if (shared->totals[pass][(from[0].square_distance >> (8 * pass)) & (RADIX - 1)] == shared->count)
+      continue;
+    // The first sweep's counts hold until a scatter moves vertices between slices
+    if (counted || shared->threads == 1)
+      memcpy(job->bucket, job->histogram[pass], sizeof(job->bucket));
+    else {
+      memset(job->bucket, 0, sizeof(job->bucket));
+      for (i = job->begin; i < job->end; i++)
+        job->bucket[(from[i].square_distance >> (8 * pass)) & (RADIX - 1)]++;
+    }
+    counted = 0;
+    pthread_barrier_wait(&shared->barrier);
+    if (job->id == 0) {
+      for (digit = 0, offset = 0; digit < RADIX; digit++)
+        for (t = 0; t < shared->threads; t++) {
+          bucket_count = shared->jobs[t].bucket[digit];
+          shared->jobs[t].bucket[digit] = offset;
+          offset += bucket_count;
+        }
+    }
+    pthread_barrier_wait(&shared->barrier);
+    for (i = job->begin; i < job->end; i++)
+      to[job->bucket[(from[i].square_distance >> (8 * pass)) & (RADIX - 1)]++] = from[i];
+    pthread_barrier_wait(&shared->barrier);
+    swap = from;
+    from = to;
+    to = swap;
+  }
+  if (job->id == 0)
+    shared->sorted = from;
+  return NULL;
+}
+
+// Returns the entries in sorted order, the caller frees them
+struct sort_entry *radix_sort(const struct vertex_arrays *vertices, int threads)
+{
+  struct sort_shared shared;
+  pthread_t *handles;
+  size_t count = vertices->count;
+  int t, started;
+
+  if ((size_t)threads > count)
+    threads = count ? count : 1;
+  shared.vertices = vertices;
+  shared.count = count;
+  shared.threads = threads;
+  shared.entries = malloc((count ? count : 1) * sizeof(struct sort_entry));
+  shared.buffer = malloc((count ? count : 1) * sizeof(struct sort_entry));
+  shared.jobs = malloc(threads * sizeof(struct sort_job));
+  handles = malloc(threads * sizeof(pthread_t));
+  if (shared.entries == NULL || shared.buffer == NULL || shared.jobs == NULL || handles == NULL) {
+    fprintf(stderr, "ERROR: failed to allocate the sort buffer for %zu vertices\n", count);
+    return NULL;
+  }
+  if (count < 2) {
+    compute_keys(vertices, shared.entries, 0, count);
+    free(shared.buffer);
+    free(shared.jobs);
+    free(handles);
+    return shared.entries;
+  }
+  pthread_barrier_init(&shared.barrier, NULL, threads);
+  for (t = 0; t < threads; t++) {
+    shared.jobs[t].shared = &shared;
+    shared.jobs[t].id = t;
+    shared.jobs[t].begin = count * t / threads;
+    shared.jobs[t].end = count * (t + 1) / threads;
+  }
+  // The calling thread sorts slice 0 itself
+  for (started = 1; started < threads; started++)
+    if (pthread_create(&handles[started], NULL, sort_thread, &shared.jobs[started]) != 0) {
+      fprintf(stderr, "ERROR: failed to start sort thread %d\n", started);
+      exit(-1);
+    }
+  sort_thread(&shared.jobs[0]);
+  for (t = 1; t < threads; t++)
+    pthread_join(handles[t], NULL);
+  pthread_barrier_destroy(&shared.barrier);
+
+  free(shared.sorted == shared.entries ? shared.buffer : shared.entries);
+  free(shared.jobs);
+  free(handles);
+  return shared.sorted;
+}
+
+// A binary file gives its vertex count up front, text grows the arrays as it is parsed
+int read_vertices(const char *path, struct vertex_arrays *vertices, size_t budget)
+{
+  struct vertex_reader reader;
+  size_t capacity;
+  int coordinate[3], result;
+
+  if (open_vertices(path, &reader) != 0)
+    return -1;
+  if (reader.binary && (check_budget(reader.count, VERTEX_BYTES, budget) != 0 || resize_arrays(vertices, reader.count) != 0)) {
+    close_vertices(&reader);
+    return -1;
+  }
+  while ((result = next_vertex(&reader, coordinate)) > 0) {
+    if (vertices->count == vertices->capacity) {
+      capacity = grow_capacity(vertices->capacity, VERTEX_BYTES, budget);
+      if (capacity == 0 || resize_arrays(vertices, capacity) != 0) {
+        result = -1;
+        break;
+      }
+    }
+    set_vertex(vertices, vertices->count++, coordinate[0], coordinate[1], coordinate[2]);
+  }
+  close_vertices(&reader);
+  return result;
+}
+
+// Save vertices in the binary format, in sorted order when sorted is given and in input order otherwise
+int write_binary(const char *path, const struct vertex_arrays *vertices, const struct sort_entry *sorted)
+{
+  FILE *fp = create_binary(path, vertices->count);
+  size_t i, vertex;
+
+  if (fp == NULL)
+    return -1;
+  for (i = 0; i < vertices->count; i++) {
+    vertex = sorted ? sorted[i].index : i;
+    put_binary(fp, vertices->x[vertex], vertices->y[vertex], vertices->z[vertex]);
+  }
+  return finish_binary(fp, path);
+}
+
+
+// Every two digit pair from 00 to 99
+const char digit_pairs[201] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Write value in decimal two digits at a time, returns the number of characters
+size_t format_int(char *out, int value)
+{
+  char digits[10];
+  char *start = digits + sizeof(digits);
+  unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+  size_t length = 0;
+
+  while (magnitude >= 100) {
+    unsigned int pair = (magnitude % 100) * 2;
+    magnitude /= 100;
+    start -= 2;
+    start[0] = digit_pairs[pair];
+    start[1] = digit_pairs[pair + 1];
+  }
+  if (magnitude >= 10) {
+    start -= 2;
+    start[0] = digit_pairs[magnitude * 2];
+    start[1] = digit_pairs[magnitude * 2 + 1];
+  }
+  else
+    *--start = '0' + magnitude;
+  if (value < 0)
+    out[length++] = '-';
+  memcpy(out + length, start, digits + sizeof(digits) - start);
+  return length + (digits + sizeof(digits) - start);
+}
+
+// Write all of data, retrying on partial writes
+int write_all(int fd, const char *data, size_t size)
+{
+  ssize_t written;
+
+  while (size > 0) {
+    written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      perror("write");
+      return -1;
+    }
+    data += written;
+    size -= written;
+  }
+  return 0;
+}
+
+// One block of sorted vertices formatted as text lines
+struct format_job {
+  const struct vertex_arrays *vertices;
+  const struct sort_entry *sorted;
+  size_t begin, end;
+  char *buffer;
+  size_t length;
+};
+
+void *format_lines(void *arg)
+{
+  struct format_job *job = arg;
+  const struct vertex_arrays *vertices = job->vertices;
+  char *out = job->buffer;
+  size_t i, vertex;
+
+  for (i = job->begin; i < job->end; i++) {
+    if (i + PREFETCH_DISTANCE < job->end) {
+      vertex = job->sorted[i + PREFETCH_DISTANCE].index;
+      __builtin_prefetch(&vertices->x[vertex]);
+      __builtin_prefetch(&vertices->y[vertex]);
+      __builtin_prefetch(&vertices->z[vertex]);
+    }
+    vertex = job->sorted[i].index;
+    out += format_int(out, vertices->x[vertex]);
+    *out++ = ' ';
+    out += format_int(out, vertices->y[vertex]);
+    *out++ = ' ';
+    out += format_int(out, vertices->z[vertex]);
+    *out++ = '\n';
+  }
+  job->length = out - job->buffer;
+  return NULL;
+}
+
+// Print the sorted vertices byte for byte like printf("%d %d %d\n") did. Each round every
+// thread formats one block into its own buffer and the blocks are then written to stdout in order
+int write_text(const struct vertex_arrays *vertices, const struct sort_entry *sorted, int threads)
+{
+  struct format_job *jobs = calloc(threads, sizeof(struct format_job));
+  pthread_t *handles = malloc(threads * sizeof(pthread_t));
+  char header[80];
+  size_t next = 0;
+  int t, active, started, result = 0;
+
+  // Every allocation is checked once here, and the cleanup below frees whatever was allocated
+  for (t = 0; jobs != NULL && t < threads; t++) {
+    jobs[t].vertices = vertices;
+    jobs[t].sorted = sorted;
+    jobs[t].buffer = malloc(FORMAT_BLOCK * LINE_BYTES);
+    if (jobs[t].buffer == NULL)
+      result = -1;
+  }
+  if (jobs == NULL || handles == NULL || result != 0) {
+    fprintf(stderr, "ERROR: failed to allocate output buffers\n");
+    result = -1;
+  }
+  else if (write_all(STDOUT_FILENO, header, snprintf(header, sizeof(header), "\nSorting %zu vectors based on distance from the origin.\n\n", vertices->count)) != 0)
+    result = -1;
+  while (result == 0 && next < vertices->count) {
+    for (active = 0; active < threads && next < vertices->count; active++) {
+      jobs[active].begin = next;
+      next = jobs[active].end = vertices->count - next > FORMAT_BLOCK ? next + FORMAT_BLOCK : vertices->count;
+    }
+    for (started = 1; started < active; started++)
+      if (pthread_create(&handles[started], NULL, format_lines, &jobs[started]) != 0) {
+        fprintf(stderr, "ERROR: failed to start output thread %d\n", started);
+        result = -1;
+        break;
+      }
+    // Join the threads that did start before giving up on the round
+    if (result == 0)
+      format_lines(&jobs[0]);
+    for (t = 1; t < started; t++)
+      pthread_join(handles[t], NULL);
+    for (t = 0; t < active && result == 0; t++)
+      result = write_all(STDOUT_FILENO, jobs[t].buffer, jobs[t].length);
+  }
+  for (t = 0; jobs != NULL && t < threads; t++)
+    free(jobs[t].buffer);
+  free(jobs);
+  free(handles);
+  return result;
+}
+
+
+int
+main(int argc, char *argv[]) {
+  struct vertex_arrays vertices = {0};
+  struct sort_entry *sorted;
+  struct vertex_options options;
+  
+  parse_options(argc, argv, "b:j:m:w:", "qsort_large [-j threads] [-m max_bytes] [-w binary_file] [-b sorted_binary_file] <file>", &options);
+  if (read_vertices(options.input_path, &vertices, options.budget) != 0)
+    exit(-1);
+  if (options.binary_path != NULL) {
+    if (write_binary(options.binary_path, &vertices, NULL) != 0)
+      exit(-1);
+    fprintf(stderr, "Wrote %zu vertices to %s\n", vertices.count, options.binary_path);
+    free_arrays(&vertices);
+    return 0;
+  }
+  if ((sorted = radix_sort(&vertices, options.threads)) == NULL)
+    exit(-1);
+
+  if (options.sorted_path != NULL) {
+    if (write_binary(options.sorted_path, &vertices, sorted) != 0)
+      exit(-1);
+    fprintf(stderr, "Wrote %zu sorted vertices to %s\n", vertices.count, options.sorted_path);
+  }
+  else if (write_text(&vertices, sorted, options.threads) != 0)
+    exit(-1);
+  free(sorted);
+  free_arrays(&vertices);
+  return 0;
+}
@@ -1,6 +1,7 @@
 // Bennett Taylor betaylor
 #include <math.h>
 #include "bits.h"
+#include "pattern.h"
 
 // BinaryMirror implementation
 unsigned int BinaryMirror(unsigned int input) {
@@ -24,28 +25,167 @@ unsigned int BinaryMirror(unsigned int input) {
         return mirror;
 }
 
-// CountSequence implemenetation
+// CountSequence implemenetation, counting the 010 pattern with the
+// general pattern counter
+static struct BitPattern sequencePattern;
+
 unsigned int CountSequence(unsigned int input) {
-	// Variables for keeping track of position and pattern match count
-	unsigned int index = 0;
-	unsigned int bound = sizeof(unsigned int) * 8;
-	unsigned int count = 0;
+	return countPattern32(&sequencePattern, input);
+}
 
-	// Traverse bits in input, starting with lowest order bit
-	while (index < bound - 2) {
-		// Generate bits for next set using a bitmask
-		int bit1 = (input & (1U << index)) != 0;
-		int bit2 = (input & (1U << (index + 1))) != 0;
-		int bit3 = (input & (1U << (index + 2))) != 0;
-		
-		// Check for pattern
-		if (!bit1 && bit2 && !bit3) {
-			count++;
-		}
+// Branch free BinaryMirror, swapping progressively larger bit groups
+static inline unsigned int MirrorScalar(unsigned int input) {
+	input = ((input >> 1) & 0x55555555U) | ((input & 0x55555555U) << 1);
+	input = ((input >> 2) & 0x33333333U) | ((input & 0x33333333U) << 2);
+	input = ((input >> 4) & 0x0F0F0F0FU) | ((input & 0x0F0F0F0FU) << 4);
+	input = ((input >> 8) & 0x00FF00FFU) | ((input & 0x00FF00FFU) << 8);
+	return (input >> 16) | (input << 16);
+}
 
-		index++;
+static void BinaryMirrorScalar(const unsigned int *in, unsigned int *out, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		out[i] = MirrorScalar(in[i]);
+	}
+}
+
+static void CountSequenceScalar(const unsigned int *in, unsigned int *out, size_t count) {
+	countPatternBatch(&sequencePattern, in, out, count);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// SSSE3 backend, four inputs per step using nibble lookup tables
+__attribute__((target("ssse3")))
+static void BinaryMirrorSSSE3(const unsigned int *in, unsigned int *out, size_t count) {
+	// Reversed nibbles, shifted up for the low nibble of each byte
+	const __m128i lowTable = _mm_setr_epi8(0x00, 0x80, 0x40, (char)0xC0, 0x20, (char)0xA0, 0x60, (char)0xE0,
+	                                       0x10, (char)0x90, 0x50, (char)0xD0, 0x30, (char)0xB0, 0x70, (char)0xF0);
+	const __m128i highTable = _mm_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+	                                        0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+	const __m128i byteSwap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)&in[i]);
+		__m128i low = _mm_shuffle_epi8(lowTable, _mm_and_si128(x, nibble));
+		__m128i high = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(x, 4), nibble));
+		x = _mm_shuffle_epi8(_mm_or_si128(low, high), byteSwap);
+		_mm_storeu_si128((__m128i *)&out[i], x);
+	}
+	BinaryMirrorScalar(&in[i], &out[i], count - i);
+}
+
+__attribute__((target("ssse3")))
+static void CountSequenceSSSE3(const unsigned int *in, unsigned int *out, size_t count) {
+	const __m128i popTable = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m128i nibble = _mm_set1_epi8(0x0F);
+	const __m128i window = _mm_set1_epi32(0x3FFFFFFF);
+	const __m128i ones8 = _mm_set1_epi8(1);
+	const __m128i ones16 = _mm_set1_epi16(1);
+	size_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i x = _mm_loadu_si128((const __m128i *)&in[i]);
+		__m128i starts = _mm_andnot_si128(x, _mm_srli_epi32(x, 1));
+		starts = _mm_andnot_si128(_mm_srli_epi32(x, 2), starts);
+		starts = _mm_and_si128(starts, window);
+
+		// Count bits per byte, then add the four bytes of each lane
+		__m128i low = _mm_shuffle_epi8(popTable, _mm_and_si128(starts, nibble));
+		__m128i high = _mm_shuffle_epi8(popTable, _mm_and_si128(_mm_srli_epi16(starts, 4), nibble));
+		__m128i bytes = _mm_add_epi8(low, high);
+		__m128i lanes = _mm_madd_epi16(_mm_maddubs_epi16(bytes, ones8), ones16);
+		_mm_storeu_si128((__m128i *)&out[i], lanes);
+	}
+	CountSequenceScalar(&in[i], &out[i], count - i);
+}
+
+// AVX2 backend, the same kernels on eight inputs per step
+__attribute__((target("avx2")))
+static void BinaryMirrorAVX2(const unsigned int *in, unsigned int *out, size_t count) {
+	const __m256i lowTable = _mm256_setr_epi8(0x00, 0x80, 0x40, (char)0xC0, 0x20, (char)0xA0, 0x60, (char)0xE0,
+	                                          0x10, (char)0x90, 0x50, (char)0xD0, 0x30, (char)0xB0, 0x70, (char)0xF0,
+	                                          0x00, 0x80, 0x40, (char)0xC0, 0x20, (char)0xA0, 0x60, (char)0xE0,
+	                                          0x10, (char)0x90, 0x50, (char)0xD0, 0x30, (char)0xB0, 0x70, (char)0xF0);
+	const __m256i highTable = _mm256_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+	                                           0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF,
+	                                           0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE,
+	                                           0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+	const __m256i byteSwap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+	                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)&in[i]);
+		__m256i low = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(x, nibble));
+		__m256i high = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+		x = _mm256_shuffle_epi8(_mm256_or_si256(low, high), byteSwap);
+		_mm256_storeu_si256((__m256i *)&out[i], x);
+	}
+	BinaryMirrorScalar(&in[i], &out[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static void CountSequenceAVX2(const unsigned int *in, unsigned int *out, size_t count) {
+	const __m256i popTable = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+	                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+	const __m256i window = _mm256_set1_epi32(0x3FFFFFFF);
+	const __m256i ones8 = _mm256_set1_epi8(1);
+	const __m256i ones16 = _mm256_set1_epi16(1);
+	size_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i x = _mm256_loadu_si256((const __m256i *)&in[i]);
+		__m256i starts = _mm256_andnot_si256(x, _mm256_srli_epi32(x, 1));
+		starts = _mm256_andnot_si256(_mm256_srli_epi32(x, 2), starts);
+		starts = _mm256_and_si256(starts, window);
+
+		__m256i low = _mm256_shuffle_epi8(popTable, _mm256_and_si256(starts, nibble));
+		__m256i high = _mm256_shuffle_epi8(popTable, _mm256_and_si256(_mm256_srli_epi16(starts, 4), nibble));
+		__m256i bytes = _mm256_add_epi8(low, high);
+		__m256i lanes = _mm256_madd_epi16(_mm256_maddubs_epi16(bytes, ones8), ones16);
+		_mm256_storeu_si256((__m256i *)&out[i], lanes);
 	}
+	CountSequenceScalar(&in[i], &out[i], count - i);
+}
+#endif
+
+// Batch backend, picked once at program startup from CPUID
+static void (*mirrorBatch)(const unsigned int *, unsigned int *, size_t) = BinaryMirrorScalar;
+static void (*sequenceBatch)(const unsigned int *, unsigned int *, size_t) = CountSequenceScalar;
+static const char *backendName = "scalar";
+
+__attribute__((constructor))
+static void SelectBackend(void) {
+	compilePattern(&sequencePattern, SEQUENCE_PATTERN);
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		mirrorBatch = BinaryMirrorAVX2;
+		sequenceBatch = CountSequenceAVX2;
+		backendName = "avx2";
+	} else if (__builtin_cpu_supports("ssse3")) {
+		mirrorBatch = BinaryMirrorSSSE3;
+		sequenceBatch = CountSequenceSSSE3;
+		backendName = "ssse3";
+	}
+#endif
+}
+
+// BinaryMirrorBatch implementation
+void BinaryMirrorBatch(const unsigned int *in, unsigned int *out, size_t count) {
+	mirrorBatch(in, out, count);
+}
+
+// CountSequenceBatch implementation
+void CountSequenceBatch(const unsigned int *in, unsigned int *out, size_t count) {
+	sequenceBatch(in, out, count);
+}
 
-	// Return pattern match count
-	return count;
+const char *BitsBackend(void) {
+	return backendName;
 }
@@ -2,8 +2,20 @@
 #ifndef BITS
 #define BITS
 
+#include <stddef.h>
+
+// Pattern counted by CountSequence
+#define SEQUENCE_PATTERN "010"
+
 // Function declarations
 unsigned int BinaryMirror(unsigned int);
 unsigned int CountSequence(unsigned int);
 
+// Batch versions, writing one result per input to the output array
+void BinaryMirrorBatch(const unsigned int *, unsigned int *, size_t);
+void CountSequenceBatch(const unsigned int *, unsigned int *, size_t);
+
+// Name of the batch backend picked for this CPU ("avx2", "ssse3" or "scalar")
+const char *BitsBackend(void);
+
 #endif
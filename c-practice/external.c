@@ -0,0 +1,606 @@
+// Bennett Taylor betaylor
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "external.h"
+#include "bits.h"
+#include "mylist.h"
+#include "records.h"
+#include "output.h"
+
+// Run files hold only the 40 bit sort key of each record, in 5 little endian
+// bytes. The key spells out the mirror's digits and the mirror gives back the
+// number and its sequence count, so nothing else needs to be stored.
+#define KEY_BYTES 5
+
+// Largest read of the input file
+#define INPUT_BLOCK (8 << 20)
+
+// Memory kept aside for the output buffer
+#define OUTPUT_RESERVE (2 << 20)
+
+// Input block for the top K mode
+#define TOP_BLOCK (1 << 20)
+
+// Smallest read buffer per run while merging, more runs merge in extra passes
+#define MIN_RUN_BUFFER (64 * 1024)
+
+// A sorted run in the temporary file
+typedef struct Run {
+	off_t offset;
+	size_t count;
+} Run;
+
+// Growable list of runs
+typedef struct RunList {
+	Run *runs;
+	size_t count;
+	size_t capacity;
+} RunList;
+
+// State shared by the run and merge phases
+typedef struct SortContext {
+	size_t budget;
+	int fd;
+	off_t fileSize;
+	RunList runs;
+} SortContext;
+
+// One run being read back during a merge
+typedef struct MergeInput {
+	off_t offset;
+	size_t remaining;
+	unsigned char *data;
+	size_t capacity;
+	size_t position;
+	size_t length;
+	unsigned long long key;
+	int done;
+} MergeInput;
+
+// Parses a budget such as 512M, with an optional K, M or G suffix. Returns 0
+// if it is not a valid size.
+size_t parseBudget(const char *text) {
+	char *end;
+	errno = 0;
+	unsigned long long value = strtoull(text, &end, 10);
+	if (end == text || errno != 0) {
+		return 0;
+	}
+	int shift = 0;
+	if (*end == 'K' || *end == 'k') {
+		shift = 10;
+	} else if (*end == 'M' || *end == 'm') {
+		shift = 20;
+	} else if (*end == 'G' || *end == 'g') {
+		shift = 30;
+	}
+	if (shift != 0) {
+		end++;
+	}
+	if (*end != '\0' || value > ((size_t)-1 >> shift)) {
+		return 0;
+	}
+	return (size_t)(value << shift);
+}
+
+static int appendRun(RunList *list, Run run) {
+	if (list->count == list->capacity) {
+		size_t capacity = list->capacity ? list->capacity * 2 : 64;
+		Run *runs = (Run *)realloc(list->runs, capacity * sizeof(Run));
+		if (runs == NULL) {
+			return 1;
+		}
+		list->runs = runs;
+		list->capacity = capacity;
+	}
+	list->runs[list->count++] = run;
+	return 0;
+}
+
+// Reads size bytes at offset, retrying on short reads. Returns 0 on success.
+static int readAt(int fd, void *data, size_t size, off_t offset) {
+	char *next = (char *)data;
+	while (size > 0) {
+		ssize_t got = pread(fd, next, size, offset);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			return 1;
+		}
+		next += got;
+		offset += got;
+		size -= got;
+	}
+	return 0;
+}
+
+// Turns a sort key back into the mirror it was built from
+static inline unsigned int keyMirror(unsigned long long key) {
+	unsigned int mirror = 0;
+	for (int shift = 36; shift >= 0; shift -= 4) {
+		unsigned int digit = (key >> shift) & 0xF;
+		if (digit == 0) {
+			break;
+		}
+		mirror = mirror * 10 + digit - 1;
+	}
+	return mirror;
+}
+
+// Writes the output lines for a batch of sorted keys
+static void outputKeys(struct OutputBuffer *output, const unsigned long long *keys, size_t count) {
+	unsigned int mirrors[RECORD_BATCH] = {0};
+	unsigned int nums[RECORD_BATCH];
+	unsigned int sequences[RECORD_BATCH];
+	for (size_t index = 0; index < count; index++) {
+		mirrors[index] = keyMirror(keys[index]);
+	}
+	BinaryMirrorBatch(mirrors, nums, count);
+	CountSequenceBatch(nums, sequences, count);
+	for (size_t index = 0; index < count; index++) {
+		outputRecord(output, mirrors[index], sequences[index]);
+	}
+}
+
+static inline void packKey(unsigned char *out, unsigned long long key) {
+	for (int index = 0; index < KEY_BYTES; index++) {
+		out[index] = (unsigned char)(key >> (8 * index));
+	}
+}
+
+// Sorts count records and appends them to the temporary file as a new run,
+// packing the keys into the scratch array that is free after sorting
+static int spillRun(SortContext *context, KeyedNode *items, KeyedNode *buffer, size_t count) {
+	KeyedNode *sorted = radixSortKeys(items, buffer, count);
+	unsigned char *packed = (unsigned char *)(sorted == items ? buffer : items);
+	for (size_t index = 0; index < count; index++) {
+		packKey(packed + index * KEY_BYTES, sorted[index].key);
+	}
+	Run run = { context->fileSize, count };
+	if (writeAll(context->fd, packed, count * KEY_BYTES) != 0 || appendRun(&context->runs, run) != 0) {
+		perror("ERROR: Writing sorted run");
+		return 1;
+	}
+	context->fileSize += (off_t)(count * KEY_BYTES);
+	return 0;
+}
+
+// Loads the next key of a run, refilling its buffer with one large read
+static int nextKey(SortContext *context, MergeInput *input) {
+	if (input->position == input->length) {
+		if (input->remaining == 0) {
+			input->done = 1;
+			return 0;
+		}
+		size_t records = input->capacity / KEY_BYTES;
+		if (records > input->remaining) {
+			records = input->remaining;
+		}
+		size_t bytes = records * KEY_BYTES;
+		if (readAt(context->fd, input->data, bytes, input->offset) != 0) {
+			perror("ERROR: Reading sorted run");
+			return 1;
+		}
+		input->offset += (off_t)bytes;
+		input->remaining -= records;
+		input->position = 0;
+		input->length = bytes;
+	}
+	const unsigned char *in = input->data + input->position;
+	input->key = (unsigned long long)in[0] | (unsigned long long)in[1] << 8 |
+		(unsigned long long)in[2] << 16 | (unsigned long long)in[3] << 24 |
+		(unsigned long long)in[4] << 32;
+	input->position += KEY_BYTES;
+	return 0;
+}
+
+// Whether run a's current key comes before run b's, earlier runs first on ties
+static inline int runBefore(const MergeInput *inputs, int a, int b) {
+	if (inputs[a].done || inputs[b].done) {
+		return !inputs[a].done;
+	}
+	return inputs[a].key < inputs[b].key || (inputs[a].key == inputs[b].key && a < b);
+}
+
+// Fills the loser tree below node and returns the winning run
+static int buildTree(const MergeInput *inputs, int *tree, int runs, int node) {
+	if (node >= runs) {
+		return node - runs;
+	}
+	int left = buildTree(inputs, tree, runs, 2 * node);
+	int right = buildTree(inputs, tree, runs, 2 * node + 1);
+	if (runBefore(inputs, left, right)) {
+		tree[node] = right;
+		return left;
+	}
+	tree[node] = left;
+	return right;
+}
+
+// Merges runs with a loser tree, either into output or, when output is NULL,
+// into a new run appended to the temporary file
+static int mergeRuns(SortContext *context, const Run *runs, int count, struct OutputBuffer *output, Run *merged) {
+	// Split the budget between the run buffers and one output buffer
+	size_t capacity = (context->budget - OUTPUT_RESERVE) / (count + 1) / KEY_BYTES * KEY_BYTES;
+	MergeInput *inputs = (MergeInput *)calloc(count, sizeof(MergeInput));
+	int *tree = (int *)malloc(count * sizeof(int));
+	unsigned char *packed = output == NULL ? (unsigned char *)malloc(capacity) : NULL;
+	int status = inputs == NULL || tree == NULL || (output == NULL && packed == NULL);
+	for (int run = 0; run < count && status == 0; run++) {
+		inputs[run].offset = runs[run].offset;
+		inputs[run].remaining = runs[run].count;
+		inputs[run].capacity = capacity;
+		inputs[run].data = (unsigned char *)malloc(capacity);
+		status = inputs[run].data == NULL || nextKey(context, &inputs[run]);
+	}
+	if (status != 0) {
+		fprintf(stderr, "ERROR: Merging sorted runs failed\n");
+	}
+
+	unsigned long long keys[RECORD_BATCH];
+	size_t batch = 0;
+	size_t used = 0;
+	if (merged != NULL) {
+		merged->offset = context->fileSize;
+		merged->count = 0;
+	}
+	int winner = status == 0 ? buildTree(inputs, tree, count, 1) : 0;
+	while (status == 0 && !inputs[winner].done) {
+		unsigned long long key = inputs[winner].key;
+		if (output != NULL) {
+			keys[batch++] = key;
+			if (batch == RECORD_BATCH) {
+				outputKeys(output, keys, batch);
+				batch = 0;
+			}
+		} else {
+			if (used + KEY_BYTES > capacity) {
+				status = writeAll(context->fd, packed, used);
+				context->fileSize += (off_t)used;
+				used = 0;
+			}
+			packKey(packed + used, key);
+			used += KEY_BYTES;
+			merged->count++;
+		}
+
+		// Advance the winning run and replay its path to the root
+		status |= nextKey(context, &inputs[winner]);
+		for (int node = (winner + count) / 2; node >= 1; node /= 2) {
+			if (runBefore(inputs, tree[node], winner)) {
+				int swap = tree[node];
+				tree[node] = winner;
+				winner = swap;
+			}
+		}
+	}
+	if (status == 0 && output != NULL) {
+		outputKeys(output, keys, batch);
+	} else if (status == 0) {
+		status = writeAll(context->fd, packed, used);
+		context->fileSize += (off_t)used;
+	}
+
+	for (int run = 0; inputs != NULL && run < count; run++) {
+		free(inputs[run].data);
+	}
+	free(inputs);
+	free(tree);
+	free(packed);
+	return status;
+}
+
+// Receives the sort keys of the next batch of input records
+typedef int (*KeyConsumer)(void *, const unsigned long long *, size_t);
+
+// Computes mirrors and sort keys for a batch of numbers and hands them on
+static int consumeBatch(const unsigned int *nums, size_t count, KeyConsumer consume, void *state) {
+	unsigned int mirrors[RECORD_BATCH];
+	unsigned long long keys[RECORD_BATCH];
+	BinaryMirrorBatch(nums, mirrors, count);
+	for (size_t index = 0; index < count; index++) {
+		keys[index] = mirrorKey(mirrors[index]);
+	}
+	return consume(state, keys, count);
+}
+
+// Reads the input in blocks of the given size, parsing every line and
+// handing the sort keys to consume a batch at a time. Returns 0 on success.
+static int readInput(int in, size_t block, KeyConsumer consume, void *state) {
+	char *text = (char *)malloc(block);
+	unsigned int nums[RECORD_BATCH];
+	size_t pending = 0;
+	size_t carry = 0;
+	int status = 0;
+	int done = 0;
+
+	if (text == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 1;
+	}
+	while (!done && status == 0) {
+		ssize_t got = read(in, text + carry, block - carry);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got < 0) {
+			perror("ERROR: Reading input");
+			status = 1;
+			break;
+		}
+		done = got == 0;
+		size_t filled = carry + got;
+
+		// Parse every complete line, or everything left at the end of the input
+		const char *end = text + filled;
+		if (!done) {
+			while (end > text && end[-1] != '\n') {
+				end--;
+			}
+		}
+		if (end == text && filled == block) {
+			fprintf(stderr, "ERROR: Invalid unsigned integer: %.*s\n", 32, text);
+			status = 1;
+			break;
+		}
+		const char *line = text;
+		while (line < end && status == 0) {
+			const char *stop = parseLine(line, end, &nums[pending]);
+			if (stop == NULL) {
+				const char *newline = memchr(line, '\n', end - line);
+				int length = (int)((newline ? newline : end) - line);
+				fprintf(stderr, "ERROR: Invalid unsigned integer: %.*s\n", length, line);
+				status = 1;
+				break;
+			}
+			line = stop + 1;
+			if (++pending == RECORD_BATCH) {
+				status = consumeBatch(nums, pending, consume, state);
+				pending = 0;
+			}
+		}
+		carry = filled - (size_t)(end - text);
+		memmove(text, end, carry);
+	}
+	if (status == 0 && pending > 0) {
+		status = consumeBatch(nums, pending, consume, state);
+	}
+	free(text);
+	return status;
+}
+
+// In memory part of the external sort, collecting keys into runs
+typedef struct RunBuilder {
+	SortContext *context;
+	KeyedNode *items;
+	KeyedNode *buffer;
+	size_t count;
+	size_t capacity;
+} RunBuilder;
+
+// Adds a batch of keys, spilling a run whenever the run arrays fill up
+static int addKeys(void *state, const unsigned long long *keys, size_t count) {
+	RunBuilder *builder = (RunBuilder *)state;
+	for (size_t index = 0; index < count; index++) {
+		builder->items[builder->count++].key = keys[index];
+		if (builder->count == builder->capacity) {
+			builder->count = 0;
+			if (spillRun(builder->context, builder->items, builder->buffer, builder->capacity) != 0) {
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Writes count sorted keys to output
+static void outputSorted(struct OutputBuffer *output, const KeyedNode *sorted, size_t count) {
+	unsigned long long keys[RECORD_BATCH];
+	for (size_t start = 0; start < count; start += RECORD_BATCH) {
+		size_t size = count - start < RECORD_BATCH ? count - start : RECORD_BATCH;
+		for (size_t index = 0; index < size; index++) {
+			keys[index] = sorted[start + index].key;
+		}
+		outputKeys(output, keys, size);
+	}
+}
+
+// Reads the input in large blocks, turning it into sorted runs of as many
+// records as fit the budget. If everything fits in one run it is written to
+// output straight away and no run is stored.
+static int formRuns(SortContext *context, int in, struct OutputBuffer *output) {
+	size_t block = context->budget / 8 < INPUT_BLOCK ? context->budget / 8 : INPUT_BLOCK;
+	RunBuilder builder;
+	builder.context = context;
+	builder.count = 0;
+	builder.capacity = (context->budget - block - OUTPUT_RESERVE) / (2 * sizeof(KeyedNode));
+	builder.items = (KeyedNode *)malloc(builder.capacity * sizeof(KeyedNode));
+	builder.buffer = (KeyedNode *)malloc(builder.capacity * sizeof(KeyedNode));
+
+	int status = 1;
+	if (builder.items == NULL || builder.buffer == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+	} else {
+		status = readInput(in, block, addKeys, &builder);
+	}
+
+	// The last records are either the only run or spilled with the others
+	if (status == 0 && builder.count > 0) {
+		if (context->runs.count > 0) {
+			status = spillRun(context, builder.items, builder.buffer, builder.count);
+		} else {
+			outputSorted(output, radixSortKeys(builder.items, builder.buffer, builder.count), builder.count);
+		}
+	}
+	free(builder.items);
+	free(builder.buffer);
+	return status;
+}
+
+// Sorts inputName into outputName using about budget bytes of memory. Runs
+// that do not fit are kept in an unlinked temporary file and merged in as
+// few passes as the budget allows. Returns 0 on success.
+int externalSortFile(const char *inputName, const char *outputName, size_t budget) {
+	SortContext context;
+	memset(&context, 0, sizeof(context));
+	context.budget = budget < MIN_BUDGET ? MIN_BUDGET : budget;
+
+	int in = open(inputName, O_RDONLY);
+	if (in < 0) {
+		perror(inputName);
+		return 1;
+	}
+	posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	// Runs go to an unlinked file in TMPDIR so nothing is left behind
+	const char *directory = getenv("TMPDIR");
+	char path[4096];
+	snprintf(path, sizeof(path), "%s/MyBitAppXXXXXX", directory ? directory : "/tmp");
+	context.fd = mkstemp(path);
+	if (context.fd < 0) {
+		perror(path);
+		close(in);
+		return 1;
+	}
+	unlink(path);
+
+	struct OutputBuffer output;
+	int status = openOutput(&output, outputName);
+	if (status == 0) {
+		status = formRuns(&context, in, &output);
+	}
+	close(in);
+
+	// Merge groups of runs until one pass can merge the rest into the output
+	int fanIn = (int)((context.budget - OUTPUT_RESERVE) / MIN_RUN_BUFFER) - 1;
+	while (status == 0 && context.runs.count > (size_t)fanIn) {
+		RunList next;
+		memset(&next, 0, sizeof(next));
+		for (size_t first = 0; first < context.runs.count && status == 0; first += fanIn) {
+			size_t group = context.runs.count - first < (size_t)fanIn ? context.runs.count - first : (size_t)fanIn;
+			Run merged = context.runs.runs[first];
+			if (group > 1) {
+				status = mergeRuns(&context, &context.runs.runs[first], (int)group, NULL, &merged);
+			}
+			status |= appendRun(&next, merged);
+		}
+		free(context.runs.runs);
+		context.runs = next;
+	}
+	if (status == 0 && context.runs.count > 0) {
+		status = mergeRuns(&context, context.runs.runs, (int)context.runs.count, &output, NULL);
+	}
+
+	if (output.fd >= 0 && closeOutput(&output) != 0) {
+		status = 1;
+	}
+	close(context.fd);
+	free(context.runs.runs);
+	return status;
+}
+
+// Max heap holding the smallest keys seen so far, at most limit of them
+typedef struct TopHeap {
+	unsigned long long *keys;
+	size_t count;
+	size_t capacity;
+	size_t limit;
+} TopHeap;
+
+static void siftDown(unsigned long long *keys, size_t count, size_t index) {
+	unsigned long long key = keys[index];
+	for (;;) {
+		size_t child = 2 * index + 1;
+		if (child >= count) {
+			break;
+		}
+		if (child + 1 < count && keys[child + 1] > keys[child]) {
+			child++;
+		}
+		if (keys[child] <= key) {
+			break;
+		}
+		keys[index] = keys[child];
+		index = child;
+	}
+	keys[index] = key;
+}
+
+// Keeps a batch of keys that beat the largest one kept so far
+static int addTop(void *state, const unsigned long long *keys, size_t count) {
+	TopHeap *heap = (TopHeap *)state;
+	for (size_t index = 0; index < count; index++) {
+		unsigned long long key = keys[index];
+		if (heap->count == heap->limit) {
+			if (key < heap->keys[0]) {
+				heap->keys[0] = key;
+				siftDown(heap->keys, heap->count, 0);
+			}
+			continue;
+		}
+
+		// Grow as records arrive, so small inputs never allocate all of limit
+		if (heap->count == heap->capacity) {
+			size_t capacity = heap->capacity ? heap->capacity * 2 : RECORD_BATCH;
+			if (capacity > heap->limit) {
+				capacity = heap->limit;
+			}
+			unsigned long long *grown = (unsigned long long *)realloc(heap->keys, capacity * sizeof(unsigned long long));
+			if (grown == NULL) {
+				fprintf(stderr, "ERROR: Out of memory\n");
+				return 1;
+			}
+			heap->keys = grown;
+			heap->capacity = capacity;
+		}
+		size_t at = heap->count++;
+		while (at > 0 && heap->keys[(at - 1) / 2] < key) {
+			heap->keys[at] = heap->keys[(at - 1) / 2];
+			at = (at - 1) / 2;
+		}
+		heap->keys[at] = key;
+	}
+	return 0;
+}
+
+// Writes the first top lines of the sorted output of inputName to
+// outputName, streaming the input through a heap of at most top keys.
+// Returns 0 on success.
+int topSortFile(const char *inputName, const char *outputName, size_t top) {
+	int in = open(inputName, O_RDONLY);
+	if (in < 0) {
+		perror(inputName);
+		return 1;
+	}
+	posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	TopHeap heap;
+	memset(&heap, 0, sizeof(heap));
+	heap.limit = top;
+	int status = readInput(in, TOP_BLOCK, addTop, &heap);
+	close(in);
+
+	// Heap sort in place, popping the largest key to the back each time
+	for (size_t count = heap.count; status == 0 && count > 1; count--) {
+		unsigned long long largest = heap.keys[0];
+		heap.keys[0] = heap.keys[count - 1];
+		heap.keys[count - 1] = largest;
+		siftDown(heap.keys, count - 1, 0);
+	}
+
+	struct OutputBuffer output;
+	if (status == 0 && (status = openOutput(&output, outputName)) == 0) {
+		for (size_t start = 0; start < heap.count; start += RECORD_BATCH) {
+			size_t size = heap.count - start < RECORD_BATCH ? heap.count - start : RECORD_BATCH;
+			outputKeys(&output, heap.keys + start, size);
+		}
+		status = closeOutput(&output);
+	}
+	free(heap.keys);
+	return status;
+}
@@ -0,0 +1,15 @@
+// Bennett Taylor betaylor
+#ifndef EXTERNAL
+#define EXTERNAL
+
+#include <stddef.h>
+
+// Smallest memory budget the external sort accepts
+#define MIN_BUDGET (4 << 20)
+
+// Function declarations
+size_t parseBudget(const char *);
+int externalSortFile(const char *, const char *, size_t);
+int topSortFile(const char *, const char *, size_t);
+
+#endif
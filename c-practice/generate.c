@@ -0,0 +1,94 @@
+// Bennett Taylor betaylor
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Previously written values that duplicates are drawn from
+#define POOL_SIZE 65536
+
+// Output is written in blocks of this size
+#define BLOCK_SIZE (1 << 20)
+
+// xorshift64* generator, the same seed always gives the same input
+static unsigned long long state;
+
+static unsigned long long nextRandom(void) {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 0x2545F4914F6CDD1DULL;
+}
+
+// Draws a fresh value from the named distribution
+static unsigned int drawValue(const char *distribution) {
+	unsigned long long random = nextRandom();
+	if (strcmp(distribution, "small") == 0) {
+		// Values below 65536
+		return (unsigned int)(random >> 48);
+	}
+	if (strcmp(distribution, "wide") == 0) {
+		// Every bit length from 1 to 32 equally likely
+		int bits = 1 + (int)((random >> 59) & 31);
+		return (unsigned int)(random >> 16) >> (32 - bits);
+	}
+	return (unsigned int)(random >> 32);
+}
+
+// Writes lines random unsigned ints to a file, a duplicate fraction of them
+// repeating earlier values
+int main(int argc, char *argv[]) {
+	if (argc != 6) {
+		printf("ERROR: Enter arguements for lines, seed, duplicate ratio, distribution (uniform, small or wide) and output file\n");
+		return 1;
+	}
+	unsigned long long lines = strtoull(argv[1], NULL, 10);
+	unsigned long long seed = strtoull(argv[2], NULL, 10);
+	double duplicates = atof(argv[3]);
+	const char *distribution = argv[4];
+	if (strcmp(distribution, "uniform") != 0 && strcmp(distribution, "small") != 0 && strcmp(distribution, "wide") != 0) {
+		printf("ERROR: Unknown distribution %s\n", distribution);
+		return 1;
+	}
+	if (duplicates < 0.0 || duplicates > 1.0) {
+		printf("ERROR: Duplicate ratio must be between 0 and 1\n");
+		return 1;
+	}
+
+	FILE *fp = fopen(argv[5], "w");
+	if (fp == NULL) {
+		perror(argv[5]);
+		return 1;
+	}
+	setvbuf(fp, NULL, _IOFBF, BLOCK_SIZE);
+
+	// Seed through splitmix so small seeds still give good streams
+	state = seed + 0x9E3779B97F4A7C15ULL;
+	state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+	state ^= state >> 31;
+	if (state == 0) {
+		state = 1;
+	}
+
+	unsigned int *pool = (unsigned int *)malloc(POOL_SIZE * sizeof(unsigned int));
+	size_t poolCount = 0;
+	unsigned long long threshold = (unsigned long long)(duplicates * 9007199254740992.0);
+	char line[16];
+	for (unsigned long long index = 0; index < lines; index++) {
+		unsigned int value;
+		if (poolCount > 0 && (nextRandom() >> 11) < threshold) {
+			value = pool[nextRandom() % poolCount];
+		} else {
+			value = drawValue(distribution);
+			if (poolCount < POOL_SIZE) {
+				pool[poolCount++] = value;
+			} else {
+				pool[nextRandom() % POOL_SIZE] = value;
+			}
+		}
+		int length = snprintf(line, sizeof(line), "%u\n", value);
+		fwrite(line, 1, length, fp);
+	}
+	free(pool);
+	return fclose(fp) != 0;
+}
@@ -1,79 +1,217 @@
 // Bennett Taylor betaylor
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
 #include "bits.h"
 #include "mylist.h"
+#include "records.h"
+#include "parallel.h"
+#include "output.h"
+#include "external.h"
+#include "pattern.h"
 
-// For generating the linked list from the input file
-void createList(struct Node **head, char *fileName) {
-	// Necessary variables for reading the file
-	FILE *fp;
-	char *line = NULL;
-	size_t len = 0;
-	struct Node *current = NULL;
-
-	// Grab each line of the input file one by one
-	fp = fopen(fileName, "r");
-	while (getline(&line, &len, fp) != -1) {
-		int index = 0;
-		// Remove newline characters and terminate string
-		while (index != -1) {
-			if (line[index] == '\n') {
-				line[index] = '\0';
-				index = -2;
-			}
-			index++;
-		}
-
-		// Create node from line
-        	struct Node *next = createNode(line);
-		line = NULL;
-
-		// Build linked list
-		if (*head == NULL) {
-			*head = next;
-			current = next;
-		}
-		else {
-			current->next = next;
-			current = next;
-		}
-    	}
-
-	fclose(fp);
-	return;
+// For generating the linked list from the input file, the file is mapped and
+// parsed in place
+int createList(struct RecordStore *store, char *fileName) {
+	if (storeMapFile(store, fileName) != 0) {
+		return 1;
+	}
+	int status = storeParse(store, store->input, store->input + store->inputSize);
+	storeDropInput(store);
+	return status;
 }
 
-// Used to output linked list to specified file
-void outputList(struct Node *head, char *fileName) {
-	FILE *fp;
-        struct Node *current = head;
-        fp = fopen(fileName, "w");
+// Writes each pattern's match count over the bits of fileName to outputName
+int countPatternsFile(const char *patterns, char *fileName, char *outputName) {
+	struct PatternSet set;
+	memset(&set, 0, sizeof(set));
+	if (addPatterns(&set, patterns) != 0) {
+		printf("ERROR: Patterns are up to %d of 0, 1 and x, at most %d bits long\n", PATTERN_MAX, PATTERN_MAX_BITS);
+		return 1;
+	}
 
-	// Print the mirror and the sequence count for each number
-	while (current != NULL) {
-		fprintf(fp, "%s\t%d\n", current->mirrorASCII, current->sequences);
-		current = current->next;
+	struct PatternStream stream;
+	if (countFilePatterns(&stream, &set, fileName) != 0) {
+		return 1;
+	}
+	FILE *fp = fopen(outputName, "w");
+	if (fp == NULL) {
+		perror(outputName);
+		return 1;
 	}
+	for (int index = 0; index < set.count; index++) {
+		fprintf(fp, "%s\t%llu\n", set.patterns[index].text, stream.counts[index]);
+	}
+	return fclose(fp) != 0;
+}
 
-	fclose(fp);
-	return;
+// Seconds on a monotonic clock
+static double seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Reports phase times, throughput and peak memory on stderr
+void printTiming(size_t records, double parse, double compute, double sort, double output) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	double total = parse + compute + sort + output;
+	fprintf(stderr, "Records: %zu\n", records);
+	fprintf(stderr, "Parse: %.3f s\n", parse);
+	fprintf(stderr, "Compute: %.3f s\n", compute);
+	fprintf(stderr, "Sort: %.3f s\n", sort);
+	fprintf(stderr, "Output: %.3f s\n", output);
+	fprintf(stderr, "Total: %.3f s, %.0f records/s\n", total, total > 0 ? records / total : 0.0);
+	fprintf(stderr, "Peak RSS: %ld KB\n", usage.ru_maxrss);
 }
 
 // Entry point
 int main(int argc, char *argv[]) {
+	// Optional -j N sets the number of worker threads, -m maps the output file
+	// and -M SIZE sorts externally within a memory budget. -c PATTERNS counts
+	// bit patterns in the input file's bits instead of sorting and --top K
+	// only keeps the first K lines of output. -t reports the time spent in
+	// each phase
+	int threads = 1;
+	int timing = 0;
+	int mapped = 0;
+	size_t budget = 0;
+	size_t top = 0;
+	const char *patterns = NULL;
+	while (argc > 3 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "-j") == 0) {
+			threads = atoi(argv[2]);
+			if (threads < 1 || threads > MAX_THREADS) {
+				printf("ERROR: Thread count must be between 1 and %d\n", MAX_THREADS);
+				return 1;
+			}
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "-M") == 0) {
+			budget = parseBudget(argv[2]);
+			if (budget == 0) {
+				printf("ERROR: Invalid memory budget %s\n", argv[2]);
+				return 1;
+			}
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "--top") == 0) {
+			char *end;
+			top = strtoull(argv[2], &end, 10);
+			if (top == 0 || *end != '\0' || argv[2][0] == '-') {
+				printf("ERROR: Invalid line count %s\n", argv[2]);
+				return 1;
+			}
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "-c") == 0) {
+			patterns = argv[2];
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "-t") == 0) {
+			timing = 1;
+			argv++;
+			argc--;
+		} else if (strcmp(argv[1], "-m") == 0) {
+			mapped = 1;
+			argv++;
+			argc--;
+		} else {
+			printf("ERROR: Unknown option %s\n", argv[1]);
+			return 1;
+		}
+	}
+
 	// Argument error checking
 	if (argc != 3) {
 		printf("ERROR: Enter arguements for input and output files\n");
 		return 1;
 	}
 
+	if (timing && (patterns != NULL || top > 0 || budget > 0)) {
+		printf("ERROR: -t cannot be combined with -c, --top or -M\n");
+		return 1;
+	}
+
+	// Count patterns over the input as one bit stream
+	if (patterns != NULL) {
+		return countPatternsFile(patterns, argv[1], argv[2]);
+	}
+
+	// Stream through a bounded heap when only the first lines are wanted
+	if (top > 0) {
+		if (threads > 1 || mapped || budget > 0) {
+			printf("ERROR: --top cannot be combined with -j, -m or -M\n");
+			return 1;
+		}
+		return topSortFile(argv[1], argv[2], top);
+	}
+
+	// Sort in bounded memory, spilling sorted runs to a temporary file
+	if (budget > 0) {
+		if (threads > 1 || mapped) {
+			printf("ERROR: -M cannot be combined with -j or -m\n");
+			return 1;
+		}
+		return externalSortFile(argv[1], argv[2], budget);
+	}
+
+	// Build and sort on worker threads, each with its own record store
+	if (threads > 1) {
+		struct RecordStore *stores = (struct RecordStore *)calloc(threads, sizeof(struct RecordStore));
+		if (stores == NULL) {
+			printf("ERROR: Out of memory\n");
+			return 1;
+		}
+		struct Node *head;
+		double parsing;
+		double start = seconds();
+		int status = parallelSortFile(argv[1], threads, stores, &head, &parsing);
+		double sorted = seconds();
+		if (status == 0) {
+			status = writeList(head, argv[2], mapped);
+		}
+		if (status == 0 && timing) {
+			// Threads compute while they parse, the slowest one sets the
+			// compute time
+			size_t records = 0;
+			double compute = 0;
+			for (int index = 0; index < threads; index++) {
+				records += stores[index].count;
+				if (stores[index].computeSeconds > compute) {
+					compute = stores[index].computeSeconds;
+				}
+			}
+			printTiming(records, parsing - compute, compute, sorted - start - parsing, seconds() - sorted);
+		}
+		for (int index = 0; index < threads; index++) {
+			freeStore(&stores[index]);
+		}
+		free(stores);
+		return status;
+	}
+
 	// Create list, sort, output to specified file, and free memory
-	struct Node *head = NULL;
-	createList(&head, argv[1]);
-	head = mergeSortList(head);
-	outputList(head, argv[2]);
-	freeList(head);
+	struct RecordStore store;
+	initStore(&store);
+	double start = seconds();
+	if (createList(&store, argv[1]) != 0) {
+		freeStore(&store);
+		return 1;
+	}
+	struct Node *head = storeList(&store);
+	double parsed = seconds();
+	head = radixSortList(head);
+	double sorted = seconds();
+	int status = writeList(head, argv[2], mapped);
+	if (status == 0 && timing) {
+		double compute = store.computeSeconds;
+		printTiming(store.count, parsed - start - compute, compute, sorted - parsed, seconds() - sorted);
+	}
+	freeStore(&store);
 
-	return 0;
+	return status;
 }
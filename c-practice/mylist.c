@@ -5,9 +5,34 @@
 #include "mylist.h"
 #include "bits.h"
 
+// Writes the number's ASCII representation into buffer, which holds NODE_ASCII_LENGTH
+char *nodeASCII(const struct Node *node, char *buffer) {
+	snprintf(buffer, NODE_ASCII_LENGTH, "%u", node->num);
+	return buffer;
+}
+
+// Writes the mirror's ASCII representation into buffer, which holds NODE_ASCII_LENGTH
+char *nodeMirrorASCII(const struct Node *node, char *buffer) {
+	snprintf(buffer, NODE_ASCII_LENGTH, "%u", node->mirror);
+	return buffer;
+}
+
+// Writes the number's binary representation into buffer, which holds NODE_BINARY_LENGTH
+char *nodeBinary(const struct Node *node, char *buffer) {
+	int bits = sizeof(unsigned int) * 8;
+	for (int index = 0; index < bits; index++) {
+		buffer[bits - index - 1] = '0' + ((node->num & (1U << index)) != 0);
+	}
+	buffer[bits] = '\0';
+	return buffer;
+}
+
 // A linked list printing function helpful for debugging
 void printList(struct Node *head) {
 	struct Node *current = head;
+	char ASCII[NODE_ASCII_LENGTH];
+	char mirrorASCII[NODE_ASCII_LENGTH];
+	char binary[NODE_BINARY_LENGTH];
 	
 	// Loop through list and print values stored in nodes
 	int index = 0;
@@ -15,9 +40,9 @@ void printList(struct Node *head) {
 		printf("Index: %d \n", index);
                 printf("Unsigned int: %u \n", current->num);
 		printf("Mirror int: %u \n", current->mirror);
-                printf("ASCII: %s \n", current->ASCII);
-		printf("Mirror ASCII: %s \n", current->mirrorASCII);
-                printf("Binary: %s \n\n", current->binary);
+                printf("ASCII: %s \n", nodeASCII(current, ASCII));
+		printf("Mirror ASCII: %s \n", nodeMirrorASCII(current, mirrorASCII));
+                printf("Binary: %s \n\n", nodeBinary(current, binary));
 		printf("Sequences: %u \n", current->sequences);
                 current = current->next;
 		index++;
@@ -25,33 +50,23 @@ void printList(struct Node *head) {
 	return;
 }
 
-// Creates a node from an unsigned int's ASCII representation
+// Creates a node from an unsigned int's ASCII representation, the string is
+// not kept and stays owned by the caller
 struct Node *createNode(char *ASCII) {
-	int bits = sizeof(unsigned int) * 8;
-
 	// Allocating neccessary space for the node
 	struct Node *node = (struct Node*)malloc(sizeof(struct Node));
-	node->mirrorASCII = (char *) malloc(sizeof(char) * 12);
 
 	// Assigning node values
-	node->ASCII = ASCII;
 	node->num = (unsigned int)atoi(ASCII);
 	node->mirror = BinaryMirror(node->num);
-	sprintf(node->mirrorASCII, "%u", node->mirror);
-	node->binary = (char*)malloc(bits + 1);
-	node->binary[bits] = '\0';
 	node->sequences = CountSequence(node->num);
-
-	// Building ASCII string to store the number's binary representation
-	int index = 0;
-	while (index < bits) {
-		node->binary[bits - index - 1] = '0' + ((node->num & (1U << index)) != 0);
-		index++;
-	}
+	node->key = mirrorKey(node->mirror);
+	node->next = NULL;
 	return node;
 }
 
-// Function for comparing the mirror ASCII representation of two nodes
+// Function for comparing the mirror ASCII representation of two nodes, using
+// the key that orders the same way
 int compareNodes(struct Node *node1, struct Node *node2) {
 	if (node1 == NULL) {
 		return 0;
@@ -59,89 +74,203 @@ int compareNodes(struct Node *node1, struct Node *node2) {
 	if (node2 == NULL) {
 		return 1;
 	}
-	return strcmp(node1->mirrorASCII, node2->mirrorASCII) < 0;
+	return node1->key < node2->key;
 }
 
-// Used for  merging pre sorted linked lists
+// Used for  merging pre sorted linked lists. Compares keys directly and
+// takes from list1 on ties, so the merge is stable.
 struct Node *mergeLists(struct Node *list1, struct Node *list2) {
-	// Pointers for building the new linked list
-	struct Node *sortedList;
-	struct Node *temp;
-
-	// Determine head of new list
-	if (compareNodes(list1, list2)) {
-		sortedList = list1;
-		list1 = list1->next;
-	} else {
-		sortedList = list2;
-		list2 = list2->next;
-	}
-
-	// Loop through list, adding nodes in sorted order
-	temp = sortedList;
-	while (list1 != NULL || list2 != NULL) {
-		if (compareNodes(list1, list2)) {
-			temp->next = list1;
-			list1 = list1->next;
-		} else {
+	struct Node sortedList;
+	struct Node *temp = &sortedList;
+
+	// Loop through both lists, adding nodes in sorted order
+	while (list1 != NULL && list2 != NULL) {
+		if (list2->key < list1->key) {
 			temp->next = list2;
 			list2 = list2->next;
+		} else {
+			temp->next = list1;
+			list1 = list1->next;
 		}
 		temp = temp->next;
 	}
-	return sortedList;
+	temp->next = list1 != NULL ? list1 : list2;
+	return sortedList.next;
+}
+
+// Detaches the run at the front of head and returns the rest of the list. A
+// run is the longest non-decreasing stretch, or a strictly decreasing one
+// which is reversed, so reversing never reorders equal keys.
+static struct Node *takeRun(struct Node *head, struct Node **run) {
+	struct Node *last = head;
+	struct Node *next = head->next;
+
+	if (next != NULL && next->key < head->key) {
+		// Reverse the descending stretch as it is walked
+		head->next = NULL;
+		while (next != NULL && next->key < last->key) {
+			struct Node *after = next->next;
+			next->next = last;
+			last = next;
+			next = after;
+		}
+		*run = last;
+		return next;
+	}
+
+	while (next != NULL && next->key >= last->key) {
+		last = next;
+		next = next->next;
+	}
+	last->next = NULL;
+	*run = head;
+	return next;
 }
 
+// Iterative natural merge sort. Runs already in order are found as they are
+// and merged like a binary counter: runs[i] holds 2^i runs merged together,
+// so no recursion or length scans are needed and sorted input is linear.
 struct Node *mergeSortList(struct Node *head) {
-	// Pointers used for breaking list into sublists
-	struct Node *slow;
-	struct Node *fast;
-
-	// Pointers used in the merge stage
-	struct Node *sortedList1;
-	struct Node *sortedList2;
-	struct Node *sortedList;
-
-	// Initialization
-	fast = head;
-	slow = head;
-	int size = 0;
-	if (head->next == NULL) {
-		return head;
+	struct Node *runs[MERGE_RUN_SLOTS] = {NULL};
+	int used = 0;
+
+	while (head != NULL) {
+		struct Node *run;
+		head = takeRun(head, &run);
+
+		// Carry the new run up through the occupied slots, earlier runs first
+		int slot = 0;
+		while (slot < used && runs[slot] != NULL) {
+			run = mergeLists(runs[slot], run);
+			runs[slot] = NULL;
+			slot++;
+		}
+		if (slot == MERGE_RUN_SLOTS) {
+			slot--;
+		}
+		runs[slot] = run;
+		if (slot == used) {
+			used++;
+		}
+	}
+
+	// Higher slots hold earlier runs
+	struct Node *sortedList = NULL;
+	for (int slot = 0; slot < used; slot++) {
+		sortedList = mergeLists(runs[slot], sortedList);
+	}
+	return sortedList;
+}
+
+// Builds an integer that orders like the decimal string of value under strcmp.
+// Each digit is stored as digit + 1 in its own nibble, most significant digit
+// first, and unused nibbles hold 0 as a terminator. A string that is a prefix
+// of another therefore gets the smaller key, so the length never has to break
+// a tie, and equal keys mean equal strings.
+unsigned long long mirrorKey(unsigned int value) {
+	unsigned char digits[10];
+	int length = 0;
+	do {
+		digits[length++] = value % 10;
+		value /= 10;
+	} while (value != 0);
+
+	unsigned long long key = 0;
+	for (int index = length - 1; index >= 0; index--) {
+		key = (key << 4) | (digits[index] + 1U);
+	}
+	return key << (4 * (10 - length));
+}
+
+// Stable LSD radix sort of size pairs by key, using buffer as scratch space.
+// Returns whichever of the two arrays holds the sorted result.
+KeyedNode *radixSortKeys(KeyedNode *items, KeyedNode *buffer, size_t size) {
+	// 10 nibbles of key, sorted a byte at a time
+	const int passes = 5;
+	size_t counts[5][256] = {{0}};
+	size_t index;
+
+	if (size < 2) {
+		return items;
 	}
 
-	// Sets slow pointer to approximately half way through the list
-	while (fast->next != NULL) {
-		if (size % 2) {
-			slow = slow->next;
+	// Histogram every digit in one pass
+	for (index = 0; index < size; index++) {
+		for (int pass = 0; pass < passes; pass++) {
+			counts[pass][(items[index].key >> (8 * pass)) & 0xFF]++;
 		}
-		fast = fast->next;
+	}
+
+	for (int pass = 0; pass < passes; pass++) {
+		// Skip passes where every key has the same byte
+		size_t *count = counts[pass];
+		if (count[(items[0].key >> (8 * pass)) & 0xFF] == size) {
+			continue;
+		}
+
+		// Turn counts into starting offsets and scatter
+		size_t offset = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			size_t next = offset + count[digit];
+			count[digit] = offset;
+			offset = next;
+		}
+		for (index = 0; index < size; index++) {
+			buffer[count[(items[index].key >> (8 * pass)) & 0xFF]++] = items[index];
+		}
+		KeyedNode *swap = items;
+		items = buffer;
+		buffer = swap;
+	}
+	return items;
+}
+
+// Sorts the list by mirror ASCII with an LSD radix sort on the node keys.
+// Each pass is stable, so nodes with equal mirrors keep their list order.
+struct Node *radixSortList(struct Node *head) {
+	size_t size = 0;
+	struct Node *current;
+
+	for (current = head; current != NULL; current = current->next) {
 		size++;
 	}
+	if (size < 2) {
+		return head;
+	}
 
-	// Breaks the list into two sublists
-	fast = slow->next;
-	slow->next = NULL;
-	slow = head;
+	KeyedNode *items = (KeyedNode *)malloc(size * sizeof(KeyedNode));
+	KeyedNode *buffer = (KeyedNode *)malloc(size * sizeof(KeyedNode));
+	if (items == NULL || buffer == NULL) {
+		free(items);
+		free(buffer);
+		return mergeSortList(head);
+	}
 
-	// Recursive merge sort call
-	sortedList1 = mergeSortList(slow);
-	sortedList2 = mergeSortList(fast);
+	// Gather keys, sort, and relink the nodes in sorted order
+	size_t index = 0;
+	for (current = head; current != NULL; current = current->next) {
+		items[index].key = current->key;
+		items[index].node = current;
+		index++;
+	}
+	KeyedNode *sorted = radixSortKeys(items, buffer, size);
+	for (index = 0; index + 1 < size; index++) {
+		sorted[index].node->next = sorted[index + 1].node;
+	}
+	sorted[size - 1].node->next = NULL;
+	head = sorted[0].node;
 
-	// Merging sorted sublists
-	sortedList = mergeLists(sortedList1, sortedList2);
-	return sortedList;
+	free(items);
+	free(buffer);
+	return head;
 }
 
 // For freeing the linked list
 void freeList(struct Node* head) {
 	struct Node *current = head;
-	// Loop through the list and free any allocated storage
+	// Loop through the list and free every node
 	while (current != NULL) {
 		head = current;
-		free(current->ASCII);
-		free(current->mirrorASCII);
-		free(current->binary);
 		current = current->next;
 		free(head);
 	}
@@ -2,25 +2,47 @@
 #ifndef MYLIST
 #define MYLIST
 
-// Linked list node definition
+#include <stddef.h>
+
+// Buffer sizes for the ASCII and binary views of a node
+#define NODE_ASCII_LENGTH 11
+#define NODE_BINARY_LENGTH (sizeof(unsigned int) * 8 + 1)
+
+// Run slots of mergeSortList, slot i holds up to 2^i runs
+#define MERGE_RUN_SLOTS 64
+
+// Linked list node definition, 32 bytes on 64 bit targets. The ASCII and
+// binary strings are formatted on demand by nodeASCII, nodeMirrorASCII and
+// nodeBinary, so repeated values have nothing left to share
 typedef struct Node {
+	// Integer with the same ordering as the mirror's ASCII under strcmp
+	unsigned long long key;
+	struct Node *next;
 	// Includes data about a number and it's binary mirror
-	char *ASCII;
 	unsigned int num;
-	char* binary;
 	unsigned int mirror;
-	char *mirrorASCII;
 	// Holds the frequency of "010" sequences found in the binary representation
 	unsigned int sequences;
-	struct Node *next;
 } Node;
 
+// Key and node pair used for array based sorting
+typedef struct KeyedNode {
+	unsigned long long key;
+	struct Node *node;
+} KeyedNode;
+
 // Function declarations
+char *nodeASCII(const struct Node *, char *);
+char *nodeMirrorASCII(const struct Node *, char *);
+char *nodeBinary(const struct Node *, char *);
 struct Node *createNode(char *);
 void printList(struct Node *);
 int compareNodes(struct Node *, struct Node *);
 struct Node *mergeLists(struct Node *, struct Node *);
 struct Node *mergeSortList(struct Node *);
+unsigned long long mirrorKey(unsigned int);
+KeyedNode *radixSortKeys(KeyedNode *, KeyedNode *, size_t);
+struct Node *radixSortList(struct Node *);
 void freeList(struct Node*);
 
 #endif
@@ -0,0 +1,194 @@
+// Bennett Taylor betaylor
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "output.h"
+
+// Output is collected in this much memory between writes
+#define OUTPUT_BUFFER (1 << 20)
+
+// Longest output line: mirror, tab, sequence count and newline
+#define LINE_LENGTH (2 * DECIMAL_LENGTH + 2)
+
+// Mapped output is written through windows of this size
+#define MAP_WINDOW (64 << 20)
+
+// Every two digit pair from 00 to 99
+static const char digitPairs[201] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+// Writes value in decimal without a terminator and returns its length
+int formatUnsigned(char *out, unsigned int value) {
+	char digits[DECIMAL_LENGTH];
+	char *end = digits + DECIMAL_LENGTH;
+	char *start = end;
+
+	// Two digits at a time from the right
+	while (value >= 100) {
+		unsigned int pair = (value % 100) * 2;
+		value /= 100;
+		start -= 2;
+		start[0] = digitPairs[pair];
+		start[1] = digitPairs[pair + 1];
+	}
+	if (value >= 10) {
+		start -= 2;
+		start[0] = digitPairs[value * 2];
+		start[1] = digitPairs[value * 2 + 1];
+	} else {
+		*--start = '0' + value;
+	}
+	int length = (int)(end - start);
+	memcpy(out, start, length);
+	return length;
+}
+
+// Formats one output line and returns its length
+static inline int formatLine(char *out, unsigned int mirror, unsigned int sequences) {
+	int length = formatUnsigned(out, mirror);
+	out[length++] = '\t';
+	length += formatUnsigned(out + length, sequences);
+	out[length++] = '\n';
+	return length;
+}
+
+// Writes all of data, retrying on partial writes. Returns 0 on success.
+int writeAll(int fd, const void *data, size_t size) {
+	const char *next = (const char *)data;
+	while (size > 0) {
+		ssize_t written = write(fd, next, size);
+		if (written < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return 1;
+		}
+		next += written;
+		size -= written;
+	}
+	return 0;
+}
+
+// Creates or truncates fileName for output. Returns 0 on success.
+int openOutput(struct OutputBuffer *output, const char *fileName) {
+	memset(output, 0, sizeof(*output));
+	output->fileName = fileName;
+	output->fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if (output->fd < 0) {
+		output->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	}
+	if (output->fd < 0) {
+		perror(fileName);
+		return 1;
+	}
+	return 0;
+}
+
+// Appends one record's line, writing the buffer out when it fills up
+void outputRecord(struct OutputBuffer *output, unsigned int mirror, unsigned int sequences) {
+	if (output->data == NULL) {
+		output->data = (char *)malloc(OUTPUT_BUFFER);
+		if (output->data == NULL) {
+			output->failed = 1;
+			return;
+		}
+	}
+	if (OUTPUT_BUFFER - output->used < LINE_LENGTH) {
+		output->failed |= writeAll(output->fd, output->data, output->used);
+		output->used = 0;
+	}
+	output->used += formatLine(output->data + output->used, mirror, sequences);
+}
+
+// Flushes and closes the output. Returns 0 if every write succeeded.
+int closeOutput(struct OutputBuffer *output) {
+	int status = output->failed;
+	if (status == 0 && output->used > 0) {
+		status = writeAll(output->fd, output->data, output->used);
+	}
+	if (close(output->fd) != 0) {
+		status = 1;
+	}
+	if (status != 0) {
+		perror(output->fileName);
+	}
+	free(output->data);
+	output->data = NULL;
+	return status;
+}
+
+// Formats straight into the mapped output file in a single pass. The file is
+// grown and mapped one window at a time and cut to the real length at the
+// end. Returns -1, with nothing written, if the output is not a regular file
+// or cannot be mapped.
+static int writeMapped(struct Node *head, int fd) {
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+		return -1;
+	}
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t used = 0;
+	struct Node *current = head;
+	while (current != NULL) {
+		// The window starts at the page holding the end of the output so far
+		size_t base = used / page * page;
+		char *window = MAP_FAILED;
+		if (ftruncate(fd, base + MAP_WINDOW) == 0) {
+			window = (char *)mmap(NULL, MAP_WINDOW, PROT_READ | PROT_WRITE, MAP_SHARED, fd, base);
+		}
+		if (window == MAP_FAILED && used == 0) {
+			// Nothing written yet, so the buffered writes can take over
+			ftruncate(fd, 0);
+			return -1;
+		}
+		if (window == MAP_FAILED) {
+			return 1;
+		}
+		char *out = window + (used - base);
+		char *limit = window + MAP_WINDOW - LINE_LENGTH;
+		for (; current != NULL && out <= limit; current = current->next) {
+			out += formatLine(out, current->mirror, current->sequences);
+		}
+		used = base + (size_t)(out - window);
+		if (munmap(window, MAP_WINDOW) != 0) {
+			return 1;
+		}
+	}
+	return ftruncate(fd, used) != 0;
+}
+
+// Writes the mirror and sequence count of every node to fileName, through a
+// memory mapping when mapped is set and the file allows it. Returns 0 on success.
+int writeList(struct Node *head, const char *fileName, int mapped) {
+	struct OutputBuffer output;
+	if (openOutput(&output, fileName) != 0) {
+		return 1;
+	}
+
+	if (mapped) {
+		output.failed = writeMapped(head, output.fd);
+	}
+
+	// Buffered writes, also used when the output cannot be mapped
+	if (!mapped || output.failed < 0) {
+		output.failed = 0;
+		for (struct Node *current = head; current != NULL; current = current->next) {
+			outputRecord(&output, current->mirror, current->sequences);
+		}
+	}
+	return closeOutput(&output);
+}
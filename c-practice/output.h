@@ -0,0 +1,28 @@
+// Bennett Taylor betaylor
+#ifndef OUTPUT
+#define OUTPUT
+
+#include <stddef.h>
+#include "mylist.h"
+
+// Longest decimal unsigned int
+#define DECIMAL_LENGTH 10
+
+// Output file with a large write buffer
+typedef struct OutputBuffer {
+	const char *fileName;
+	int fd;
+	char *data;
+	size_t used;
+	int failed;
+} OutputBuffer;
+
+// Function declarations
+int formatUnsigned(char *, unsigned int);
+int writeAll(int, const void *, size_t);
+int openOutput(struct OutputBuffer *, const char *);
+void outputRecord(struct OutputBuffer *, unsigned int, unsigned int);
+int closeOutput(struct OutputBuffer *);
+int writeList(struct Node *, const char *, int);
+
+#endif
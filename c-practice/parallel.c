@@ -0,0 +1,304 @@
+// Bennett Taylor betaylor
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "parallel.h"
+
+// Samples taken from every sorted chunk to choose the merge splitters
+#define SAMPLES_PER_CHUNK 64
+
+// One slice of the input, parsed and sorted by a single thread
+typedef struct ChunkJob {
+	const char *start;
+	const char *end;
+	struct RecordStore *store;
+	KeyedNode *items;
+	KeyedNode *buffer;
+	KeyedNode *sorted;
+	size_t count;
+	int failed;
+} ChunkJob;
+
+// One key range of the final order, merged from every chunk by a single thread
+typedef struct MergeJob {
+	ChunkJob *chunks;
+	int chunkCount;
+	size_t *begin;
+	size_t *end;
+	KeyedNode *out;
+	size_t count;
+} MergeJob;
+
+// Builds the records for one chunk of lines
+static void *parseChunk(void *arg) {
+	ChunkJob *job = (ChunkJob *)arg;
+	if (storeParse(job->store, job->start, job->end) != 0) {
+		job->failed = 1;
+	}
+	return NULL;
+}
+
+// Sorts the records of one parsed chunk as an array of keys
+static void *sortChunk(void *arg) {
+	ChunkJob *job = (ChunkJob *)arg;
+	job->count = job->store->count;
+	job->items = (KeyedNode *)malloc((job->count + 1) * sizeof(KeyedNode));
+	job->buffer = (KeyedNode *)malloc((job->count + 1) * sizeof(KeyedNode));
+	if (job->items == NULL || job->buffer == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		job->failed = 1;
+		return NULL;
+	}
+	size_t index = 0;
+	for (struct Node *current = storeList(job->store); current != NULL; current = current->next) {
+		job->items[index].key = current->key;
+		job->items[index].node = current;
+		index++;
+	}
+	job->sorted = radixSortKeys(job->items, job->buffer, job->count);
+	return NULL;
+}
+
+// First position in a sorted chunk whose key is greater than key
+static size_t upperBound(const KeyedNode *items, size_t count, unsigned long long key) {
+	size_t low = 0;
+	size_t high = count;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (items[middle].key <= key) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// Merges one key range of every chunk, taking the earlier chunk on equal keys
+static void *mergeRange(void *arg) {
+	MergeJob *job = (MergeJob *)arg;
+	size_t *position = (size_t *)malloc(job->chunkCount * sizeof(size_t));
+	int *heap = (int *)malloc(job->chunkCount * sizeof(int));
+	int heapSize = 0;
+	size_t out = 0;
+
+	// Min-heap of chunk indexes ordered by (key, chunk)
+	#define HEAD(chunk) (job->chunks[chunk].sorted[position[chunk]].key)
+	#define LESS(a, b) (HEAD(a) < HEAD(b) || (HEAD(a) == HEAD(b) && (a) < (b)))
+	for (int chunk = 0; chunk < job->chunkCount; chunk++) {
+		position[chunk] = job->begin[chunk];
+		if (position[chunk] < job->end[chunk]) {
+			int index = heapSize++;
+			while (index > 0 && LESS(chunk, heap[(index - 1) / 2])) {
+				heap[index] = heap[(index - 1) / 2];
+				index = (index - 1) / 2;
+			}
+			heap[index] = chunk;
+		}
+	}
+	while (heapSize > 0) {
+		int chunk = heap[0];
+		job->out[out++] = job->chunks[chunk].sorted[position[chunk]++];
+		if (position[chunk] == job->end[chunk]) {
+			chunk = heap[--heapSize];
+		}
+
+		// Sift the replacement down from the root
+		int index = 0;
+		for (;;) {
+			int child = 2 * index + 1;
+			if (child >= heapSize) {
+				break;
+			}
+			if (child + 1 < heapSize && LESS(heap[child + 1], heap[child])) {
+				child++;
+			}
+			if (!LESS(heap[child], chunk)) {
+				break;
+			}
+			heap[index] = heap[child];
+			index = child;
+		}
+		if (heapSize > 0) {
+			heap[index] = chunk;
+		}
+	}
+	#undef LESS
+	#undef HEAD
+
+	// Link the nodes of this range, the main thread joins the ranges
+	for (size_t index = 0; index + 1 < out; index++) {
+		job->out[index].node->next = job->out[index + 1].node;
+	}
+	job->count = out;
+	free(position);
+	free(heap);
+	return NULL;
+}
+
+static int compareKeys(const void *a, const void *b) {
+	unsigned long long keyA = *(const unsigned long long *)a;
+	unsigned long long keyB = *(const unsigned long long *)b;
+	return (keyA > keyB) - (keyA < keyB);
+}
+
+// Seconds on a monotonic clock
+static double seconds(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Runs job on threads workers, one element of jobs each. Jobs whose thread
+// cannot be started run on the calling thread instead.
+static void runJobs(int threads, void *(*job)(void *), void *jobs, size_t jobSize) {
+	pthread_t workers[MAX_THREADS];
+	int started = 0;
+	while (started < threads &&
+			pthread_create(&workers[started], NULL, job, (char *)jobs + started * jobSize) == 0) {
+		started++;
+	}
+	for (int index = started; index < threads; index++) {
+		job((char *)jobs + index * jobSize);
+	}
+	for (int index = 0; index < started; index++) {
+		pthread_join(workers[index], NULL);
+	}
+}
+
+// Maps fileName, builds and sorts its records on threads workers and stores
+// the sorted list in head. Records live in stores, one per thread, for the
+// caller to free. Every thread finishes parsing before sorting starts, and
+// parseSeconds gets the time the parsing took. Returns 0 on success and 1 on
+// failure.
+int parallelSortFile(char *fileName, int threads, struct RecordStore *stores, struct Node **head,
+		double *parseSeconds) {
+	*head = NULL;
+	*parseSeconds = 0;
+	if (threads < 1 || threads > MAX_THREADS) {
+		return 1;
+	}
+	for (int index = 0; index < threads; index++) {
+		initStore(&stores[index]);
+	}
+	if (storeMapFile(&stores[0], fileName) != 0) {
+		return 1;
+	}
+	const char *text = stores[0].input;
+	size_t size = stores[0].inputSize;
+
+	// Cut the input at line boundaries
+	ChunkJob *chunks = (ChunkJob *)calloc(threads, sizeof(ChunkJob));
+	if (chunks == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 1;
+	}
+	const char *start = text;
+	for (int index = 0; index < threads; index++) {
+		const char *end = text + size * (index + 1) / threads;
+		if (end < start) {
+			end = start;
+		}
+		if (index == threads - 1) {
+			end = text + size;
+		} else {
+			const char *newline = memchr(end, '\n', text + size - end);
+			end = newline ? newline + 1 : text + size;
+		}
+		chunks[index].start = start;
+		chunks[index].end = end;
+		chunks[index].store = &stores[index];
+		start = end;
+	}
+	double parseStart = seconds();
+	runJobs(threads, parseChunk, chunks, sizeof(ChunkJob));
+	*parseSeconds = seconds() - parseStart;
+	storeDropInput(&stores[0]);
+
+	size_t total = 0;
+	int failed = 0;
+	for (int index = 0; index < threads; index++) {
+		failed |= chunks[index].failed;
+	}
+	if (!failed) {
+		runJobs(threads, sortChunk, chunks, sizeof(ChunkJob));
+	}
+	for (int index = 0; index < threads; index++) {
+		total += chunks[index].count;
+		failed |= chunks[index].failed;
+	}
+
+	int status = 0;
+	KeyedNode *merged = (KeyedNode *)malloc((total + 1) * sizeof(KeyedNode));
+	MergeJob *merges = (MergeJob *)calloc(threads, sizeof(MergeJob));
+	size_t *bounds = (size_t *)malloc((threads + 1) * threads * sizeof(size_t));
+	unsigned long long *samples = (unsigned long long *)malloc(threads * SAMPLES_PER_CHUNK * sizeof(unsigned long long));
+	if (failed) {
+		status = 1;
+	} else if (merged == NULL || merges == NULL || bounds == NULL || samples == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		status = 1;
+	} else if (total > 0) {
+		// Choose splitters from evenly spaced samples of the sorted chunks
+		int sampleCount = 0;
+		for (int index = 0; index < threads; index++) {
+			for (size_t sample = 0; sample < SAMPLES_PER_CHUNK && chunks[index].count > 0; sample++) {
+				size_t at = chunks[index].count * sample / SAMPLES_PER_CHUNK;
+				samples[sampleCount++] = chunks[index].sorted[at].key;
+			}
+		}
+		qsort(samples, sampleCount, sizeof(unsigned long long), compareKeys);
+
+		// Range r covers keys up to its splitter in every chunk, equal keys
+		// never straddle two ranges
+		for (int chunk = 0; chunk < threads; chunk++) {
+			bounds[chunk] = 0;
+			bounds[threads * threads + chunk] = chunks[chunk].count;
+		}
+		for (int range = 1; range < threads; range++) {
+			unsigned long long splitter = samples[(size_t)sampleCount * range / threads];
+			for (int chunk = 0; chunk < threads; chunk++) {
+				size_t at = upperBound(chunks[chunk].sorted, chunks[chunk].count, splitter);
+				size_t previous = bounds[(range - 1) * threads + chunk];
+				bounds[range * threads + chunk] = at > previous ? at : previous;
+			}
+		}
+
+		// Merge every range on its own thread into its slice of the output
+		size_t offset = 0;
+		for (int range = 0; range < threads; range++) {
+			merges[range].chunks = chunks;
+			merges[range].chunkCount = threads;
+			merges[range].begin = &bounds[range * threads];
+			merges[range].end = &bounds[(range + 1) * threads];
+			merges[range].out = &merged[offset];
+			for (int chunk = 0; chunk < threads; chunk++) {
+				offset += merges[range].end[chunk] - merges[range].begin[chunk];
+			}
+		}
+		runJobs(threads, mergeRange, merges, sizeof(MergeJob));
+
+		// Join the ranges at their boundaries, each is already linked inside
+		struct Node **link = head;
+		for (int range = 0; range < threads; range++) {
+			if (merges[range].count > 0) {
+				*link = merges[range].out[0].node;
+				link = &merges[range].out[merges[range].count - 1].node->next;
+			}
+		}
+		*link = NULL;
+	}
+
+	for (int index = 0; index < threads; index++) {
+		free(chunks[index].items);
+		free(chunks[index].buffer);
+	}
+	free(chunks);
+	free(merged);
+	free(merges);
+	free(bounds);
+	free(samples);
+	return status;
+}
@@ -0,0 +1,14 @@
+// Bennett Taylor betaylor
+#ifndef PARALLEL
+#define PARALLEL
+
+#include "mylist.h"
+#include "records.h"
+
+// Upper bound for the -j option
+#define MAX_THREADS 256
+
+// Function declarations
+int parallelSortFile(char *, int, struct RecordStore *, struct Node **, double *);
+
+#endif
@@ -0,0 +1,307 @@
+// Bennett Taylor betaylor
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "pattern.h"
+
+// Bytes read from a file per call
+#define STREAM_BLOCK (1 << 20)
+
+// Match kernels. Patterns with up to KERNEL_TERMS fixed bits use a term loop
+// of constant length, which the compiler unrolls, and 010 uses constant
+// shifts. Longer patterns use the general term loop.
+#define KERNEL_TERMS 4
+#define KERNEL_010 (KERNEL_TERMS + 1)
+#define KERNEL_GENERAL (KERNEL_TERMS + 2)
+
+// Builds the match kernel for a pattern. Returns 0 on success.
+int compilePattern(struct BitPattern *pattern, const char *text) {
+	size_t length = strlen(text);
+	if (length == 0 || length > PATTERN_MAX_BITS) {
+		return 1;
+	}
+	memset(pattern, 0, sizeof(*pattern));
+	memcpy(pattern->text, text, length);
+	pattern->length = (unsigned int)length;
+
+	// The last character lines up with the lowest bit of a match
+	for (size_t index = 0; index < length; index++) {
+		char bit = text[length - index - 1];
+		if (bit == 'x' || bit == '?') {
+			continue;
+		}
+		if (bit != '0' && bit != '1') {
+			return 1;
+		}
+		pattern->shift[pattern->terms] = (unsigned char)index;
+		pattern->flip[pattern->terms] = bit == '0' ? ~0ULL : 0;
+		pattern->terms++;
+	}
+
+	if (strcmp(pattern->text, "010") == 0) {
+		pattern->kernel = KERNEL_010;
+	} else if (pattern->terms <= KERNEL_TERMS) {
+		pattern->kernel = pattern->terms;
+	} else {
+		pattern->kernel = KERNEL_GENERAL;
+	}
+	return 0;
+}
+
+// Adds a comma separated list of patterns to the set. Returns 0 on success.
+int addPatterns(struct PatternSet *set, const char *list) {
+	char text[PATTERN_MAX_BITS + 1];
+	while (*list != '\0') {
+		size_t length = strcspn(list, ",");
+		if (set->count == PATTERN_MAX || length > PATTERN_MAX_BITS) {
+			return 1;
+		}
+		memcpy(text, list, length);
+		text[length] = '\0';
+		if (compilePattern(&set->patterns[set->count], text) != 0) {
+			return 1;
+		}
+		set->count++;
+		list += length;
+		if (*list == ',') {
+			list++;
+		}
+	}
+	return set->count == 0;
+}
+
+// One bit per position where a match ends, the lowest bit of each match.
+// Positions too close to the top of the word are masked by the callers.
+static inline __attribute__((always_inline))
+unsigned long long matchTerms(const struct BitPattern *pattern, unsigned long long word, unsigned int terms) {
+	unsigned long long ends = ~0ULL;
+	for (unsigned int term = 0; term < terms; term++) {
+		ends &= (word ^ pattern->flip[term]) >> pattern->shift[term];
+	}
+	return ends;
+}
+
+// Called with a constant kernel the switch folds away, leaving straight
+// line code for that kernel
+static inline __attribute__((always_inline))
+unsigned long long matchKernel(const struct BitPattern *pattern, unsigned long long word, unsigned int kernel) {
+	switch (kernel) {
+	case 0:
+		return ~0ULL;
+	case 1:
+		return matchTerms(pattern, word, 1);
+	case 2:
+		return matchTerms(pattern, word, 2);
+	case 3:
+		return matchTerms(pattern, word, 3);
+	case 4:
+		return matchTerms(pattern, word, 4);
+	case KERNEL_010:
+		return ~word & (word >> 1) & ~(word >> 2);
+	default:
+		return matchTerms(pattern, word, pattern->terms);
+	}
+}
+
+static inline unsigned long long matchEnds(const struct BitPattern *pattern, unsigned long long word) {
+	return matchKernel(pattern, word, pattern->kernel);
+}
+
+// Matches that fit entirely inside a 32 bit word
+unsigned int countPattern32(const struct BitPattern *pattern, unsigned int word) {
+	unsigned long long window = (1ULL << (32 - pattern->length + 1)) - 1;
+	return __builtin_popcountll(matchEnds(pattern, word) & window);
+}
+
+// Matches that fit entirely inside a 64 bit word
+unsigned int countPattern64(const struct BitPattern *pattern, unsigned long long word) {
+	unsigned int positions = 64 - pattern->length + 1;
+	unsigned long long window = positions == 64 ? ~0ULL : (1ULL << positions) - 1;
+	return __builtin_popcountll(matchEnds(pattern, word) & window);
+}
+
+static inline __attribute__((always_inline))
+void batchKernel(const struct BitPattern *pattern, const unsigned int *in, unsigned int *out, size_t count, unsigned int kernel) {
+	unsigned long long window = (1ULL << (32 - pattern->length + 1)) - 1;
+	for (size_t i = 0; i < count; i++) {
+		out[i] = __builtin_popcountll(matchKernel(pattern, in[i], kernel) & window);
+	}
+}
+
+// Counts for each of count words, one result per input, with the loop
+// specialized for the pattern's kernel
+void countPatternBatch(const struct BitPattern *pattern, const unsigned int *in, unsigned int *out, size_t count) {
+	switch (pattern->kernel) {
+	case 0:
+		batchKernel(pattern, in, out, count, 0);
+		break;
+	case 1:
+		batchKernel(pattern, in, out, count, 1);
+		break;
+	case 2:
+		batchKernel(pattern, in, out, count, 2);
+		break;
+	case 3:
+		batchKernel(pattern, in, out, count, 3);
+		break;
+	case 4:
+		batchKernel(pattern, in, out, count, 4);
+		break;
+	case KERNEL_010:
+		batchKernel(pattern, in, out, count, KERNEL_010);
+		break;
+	default:
+		batchKernel(pattern, in, out, count, KERNEL_GENERAL);
+		break;
+	}
+}
+
+void streamInit(struct PatternStream *stream, const struct PatternSet *set) {
+	memset(stream, 0, sizeof(*stream));
+	stream->set = set;
+}
+
+// The bits of word shifted down by shift, with the bits of previous filling
+// in from the top
+static inline __attribute__((always_inline))
+unsigned long long streamShift(unsigned long long word, unsigned long long previous, unsigned int shift) {
+	return shift == 0 ? word : word >> shift | previous << (64 - shift);
+}
+
+static inline __attribute__((always_inline))
+unsigned long long streamTerms(const struct BitPattern *pattern, unsigned long long word,
+		unsigned long long previous, unsigned int terms) {
+	unsigned long long ends = ~0ULL;
+	for (unsigned int term = 0; term < terms; term++) {
+		unsigned long long flip = pattern->flip[term];
+		ends &= streamShift(word ^ flip, previous ^ flip, pattern->shift[term]);
+	}
+	return ends;
+}
+
+// Match ends in word, as matchKernel but with earlier bits from previous
+static inline unsigned long long streamEnds(const struct BitPattern *pattern, unsigned long long word,
+		unsigned long long previous) {
+	switch (pattern->kernel) {
+	case 0:
+		return ~0ULL;
+	case 1:
+		return streamTerms(pattern, word, previous, 1);
+	case 2:
+		return streamTerms(pattern, word, previous, 2);
+	case 3:
+		return streamTerms(pattern, word, previous, 3);
+	case 4:
+		return streamTerms(pattern, word, previous, 4);
+	case KERNEL_010:
+		return ~word & streamShift(word, previous, 1) & ~streamShift(word, previous, 2);
+	default:
+		return streamTerms(pattern, word, previous, pattern->terms);
+	}
+}
+
+// Matches ending in word. Earlier bits come from previous, so matches across
+// the word boundary count once. valid is the number of stream bits in word.
+static void streamWord(struct PatternStream *stream, unsigned long long word, unsigned int valid) {
+	const struct PatternSet *set = stream->set;
+	for (int index = 0; index < set->count; index++) {
+		const struct BitPattern *pattern = &set->patterns[index];
+		unsigned long long ends = streamEnds(pattern, word, stream->previous);
+
+		// Drop ends in the padding and, in the first word, matches that
+		// would start before the stream
+		if (valid < 64) {
+			ends &= ~0ULL << (64 - valid);
+		}
+		if (stream->words == 0 && pattern->length > 1) {
+			ends &= ~0ULL >> (pattern->length - 1);
+		}
+		stream->counts[index] += __builtin_popcountll(ends);
+	}
+	stream->previous = word;
+	stream->words++;
+}
+
+static inline unsigned long long loadWord(const unsigned char *bytes) {
+	unsigned long long word = 0;
+	for (int index = 0; index < 8; index++) {
+		word = word << 8 | bytes[index];
+	}
+	return word;
+}
+
+// Adds length more bytes of the stream
+void streamFeed(struct PatternStream *stream, const unsigned char *bytes, size_t length) {
+	// Complete a word left over from the previous call
+	if (stream->partialLength > 0) {
+		size_t take = 8 - stream->partialLength;
+		if (take > length) {
+			take = length;
+		}
+		memcpy(stream->partial + stream->partialLength, bytes, take);
+		stream->partialLength += take;
+		bytes += take;
+		length -= take;
+		if (stream->partialLength < 8) {
+			return;
+		}
+		streamWord(stream, loadWord(stream->partial), 64);
+		stream->partialLength = 0;
+	}
+
+	// Whole words, then keep the tail for later
+	for (; length >= 8; bytes += 8, length -= 8) {
+		streamWord(stream, loadWord(bytes), 64);
+	}
+	memcpy(stream->partial, bytes, length);
+	stream->partialLength = length;
+}
+
+// Counts matches in the last partial word
+void streamFinish(struct PatternStream *stream) {
+	if (stream->partialLength > 0) {
+		memset(stream->partial + stream->partialLength, 0, 8 - stream->partialLength);
+		streamWord(stream, loadWord(stream->partial), (unsigned int)stream->partialLength * 8);
+		stream->partialLength = 0;
+	}
+}
+
+// Counts every pattern of set in the bits of fileName, each byte first bit
+// first. Returns 0 on success.
+int countFilePatterns(struct PatternStream *stream, const struct PatternSet *set, const char *fileName) {
+	int fd = open(fileName, O_RDONLY);
+	if (fd < 0) {
+		perror(fileName);
+		return 1;
+	}
+	unsigned char *block = (unsigned char *)malloc(STREAM_BLOCK);
+	if (block == NULL) {
+		close(fd);
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 1;
+	}
+
+	streamInit(stream, set);
+	int status = 0;
+	for (;;) {
+		ssize_t got = read(fd, block, STREAM_BLOCK);
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got < 0) {
+			perror(fileName);
+			status = 1;
+		}
+		if (got <= 0) {
+			break;
+		}
+		streamFeed(stream, block, (size_t)got);
+	}
+	streamFinish(stream);
+	free(block);
+	close(fd);
+	return status;
+}
@@ -0,0 +1,51 @@
+// Bennett Taylor betaylor
+#ifndef PATTERN
+#define PATTERN
+
+#include <stddef.h>
+
+// Longest pattern and most patterns counted together
+#define PATTERN_MAX_BITS 16
+#define PATTERN_MAX 16
+
+// A bit pattern such as "010" or "1x0", written first bit first as in a
+// number's binary representation. Each fixed bit becomes one shift term of
+// the match kernel, wildcards ('x' or '?') add none. kernel picks the
+// specialized match code for the pattern.
+typedef struct BitPattern {
+	char text[PATTERN_MAX_BITS + 1];
+	unsigned int length;
+	unsigned int terms;
+	unsigned int kernel;
+	unsigned char shift[PATTERN_MAX_BITS];
+	unsigned long long flip[PATTERN_MAX_BITS];
+} BitPattern;
+
+// Patterns counted in one pass over the input
+typedef struct PatternSet {
+	int count;
+	BitPattern patterns[PATTERN_MAX];
+} PatternSet;
+
+// Bit stream counting state, fed bytes first bit first in any sized pieces
+typedef struct PatternStream {
+	const PatternSet *set;
+	unsigned long long counts[PATTERN_MAX];
+	unsigned long long previous;
+	unsigned long long words;
+	unsigned char partial[8];
+	size_t partialLength;
+} PatternStream;
+
+// Function declarations
+int compilePattern(struct BitPattern *, const char *);
+int addPatterns(struct PatternSet *, const char *);
+unsigned int countPattern32(const struct BitPattern *, unsigned int);
+unsigned int countPattern64(const struct BitPattern *, unsigned long long);
+void countPatternBatch(const struct BitPattern *, const unsigned int *, unsigned int *, size_t);
+void streamInit(struct PatternStream *, const struct PatternSet *);
+void streamFeed(struct PatternStream *, const unsigned char *, size_t);
+void streamFinish(struct PatternStream *);
+int countFilePatterns(struct PatternStream *, const struct PatternSet *, const char *);
+
+#endif
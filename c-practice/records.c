@@ -0,0 +1,244 @@
+// Bennett Taylor betaylor
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "records.h"
+#include "bits.h"
+
+// Chunks start small and double up to this size
+#define FIRST_CHUNK (64 * 1024)
+#define MAX_CHUNK (64 * 1024 * 1024)
+
+void initStore(struct RecordStore *store) {
+	memset(store, 0, sizeof(*store));
+}
+
+// Bump allocates size bytes, adding a bigger chunk when the current one is full
+static void *storeAlloc(struct RecordStore *store, size_t size) {
+	size = (size + 7) & ~(size_t)7;
+	RecordChunk *chunk = store->chunks;
+	if (chunk == NULL || chunk->size - chunk->used < size) {
+		size_t chunkSize = chunk ? chunk->size * 2 : FIRST_CHUNK;
+		if (chunkSize > MAX_CHUNK) {
+			chunkSize = MAX_CHUNK;
+		}
+		if (chunkSize < size) {
+			chunkSize = size;
+		}
+		chunk = (RecordChunk *)malloc(sizeof(RecordChunk) + chunkSize);
+		if (chunk == NULL) {
+			return NULL;
+		}
+		chunk->next = store->chunks;
+		chunk->used = 0;
+		chunk->size = chunkSize;
+		store->chunks = chunk;
+		store->bytes += sizeof(RecordChunk) + chunkSize;
+	}
+	void *memory = chunk->data + chunk->used;
+	chunk->used += size;
+	return memory;
+}
+
+// Computes mirrors and sequence counts for the pending nodes in one batch
+static void storeFlush(struct RecordStore *store) {
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	unsigned int nums[RECORD_BATCH];
+	unsigned int mirrors[RECORD_BATCH];
+	unsigned int sequences[RECORD_BATCH];
+	size_t count = store->pendingCount;
+
+	for (size_t i = 0; i < count; i++) {
+		nums[i] = store->pending[i]->num;
+	}
+	BinaryMirrorBatch(nums, mirrors, count);
+	CountSequenceBatch(nums, sequences, count);
+
+	for (size_t i = 0; i < count; i++) {
+		struct Node *node = store->pending[i];
+		node->mirror = mirrors[i];
+		node->sequences = sequences[i];
+		node->key = mirrorKey(node->mirror);
+	}
+	store->pendingCount = 0;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	store->computeSeconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+// Appends a node for num
+struct Node *storeAppend(struct RecordStore *store, unsigned int num) {
+	struct Node *node = (struct Node *)storeAlloc(store, sizeof(struct Node));
+	if (node == NULL) {
+		return NULL;
+	}
+	node->num = num;
+	node->next = NULL;
+
+	// Build linked list
+	if (store->head == NULL) {
+		store->head = node;
+	} else {
+		store->tail->next = node;
+	}
+	store->tail = node;
+	store->count++;
+
+	store->pending[store->pendingCount++] = node;
+	if (store->pendingCount == RECORD_BATCH) {
+		storeFlush(store);
+	}
+	return node;
+}
+
+// Maps fileName read only as the store's input. A zero page is mapped right
+// after the file so the text is always NUL terminated. Files that cannot be
+// mapped, such as pipes, are read into memory instead. Returns 0 on success.
+int storeMapFile(struct RecordStore *store, const char *fileName) {
+	int fd = open(fileName, O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0) {
+		perror(fileName);
+		if (fd >= 0) {
+			close(fd);
+		}
+		return 1;
+	}
+
+	if (S_ISREG(info.st_mode)) {
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		size_t size = (size_t)info.st_size;
+		size_t reserve = (size / page + 1) * page;
+		char *base = (char *)mmap(NULL, reserve, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base != MAP_FAILED && (size == 0 ||
+		    mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) != MAP_FAILED)) {
+			madvise(base, reserve, MADV_SEQUENTIAL);
+			close(fd);
+			store->input = base;
+			store->inputSize = size;
+			store->inputMapped = 1;
+			return 0;
+		}
+		if (base != MAP_FAILED) {
+			munmap(base, reserve);
+		}
+	}
+
+	// Fall back to reading the whole file
+	size_t capacity = 1 << 16;
+	size_t size = 0;
+	char *text = (char *)malloc(capacity);
+	ssize_t got;
+	while (text != NULL && (got = read(fd, text + size, capacity - size - 1)) > 0) {
+		size += got;
+		if (capacity - size == 1) {
+			char *grown = (char *)realloc(text, capacity * 2);
+			if (grown == NULL) {
+				free(text);
+			}
+			text = grown;
+			capacity *= 2;
+		}
+	}
+	close(fd);
+	if (text == NULL) {
+		fprintf(stderr, "ERROR: Out of memory\n");
+		return 1;
+	}
+	text[size] = '\0';
+	store->input = text;
+	store->inputSize = size;
+	store->inputMapped = 0;
+	return 0;
+}
+
+// Parses one line of unsigned decimal text into num, allowing a trailing
+// carriage return. A blank line reads as 0 like the original atoi parser.
+// Returns the end of the line or NULL if it is not a valid unsigned int.
+const char *parseLine(const char *text, const char *end, unsigned int *num) {
+	while (text < end && *text == '0') {
+		text++;
+	}
+
+	// At most 10 significant digits, so the value fits before the range check
+	const char *digits = text;
+	unsigned long long value = 0;
+	while (text < end && (unsigned char)(*text - '0') < 10) {
+		if (text - digits == 10) {
+			return NULL;
+		}
+		value = value * 10 + (*text - '0');
+		text++;
+	}
+	if (value > UINT_MAX) {
+		return NULL;
+	}
+	if (text < end && *text == '\r') {
+		text++;
+	}
+	if (text < end && *text != '\n') {
+		return NULL;
+	}
+	*num = (unsigned int)value;
+	return text;
+}
+
+// Appends a node for every line between start and end. Returns 0 on success.
+int storeParse(struct RecordStore *store, const char *start, const char *end) {
+	const char *line = start;
+	while (line < end) {
+		unsigned int num;
+		const char *stop = parseLine(line, end, &num);
+		if (stop == NULL) {
+			const char *newline = memchr(line, '\n', end - line);
+			int length = (int)((newline ? newline : end) - line);
+			fprintf(stderr, "ERROR: Invalid unsigned integer: %.*s\n", length, line);
+			return 1;
+		}
+		if (storeAppend(store, num) == NULL) {
+			fprintf(stderr, "ERROR: Out of memory\n");
+			return 1;
+		}
+		line = stop + 1;
+	}
+	return 0;
+}
+
+// Returns the list of all stored nodes with every field filled in
+struct Node *storeList(struct RecordStore *store) {
+	storeFlush(store);
+	return store->head;
+}
+
+// Releases the input text, nodes do not point into it
+void storeDropInput(struct RecordStore *store) {
+	if (store->input == NULL) {
+		return;
+	}
+	if (store->inputMapped) {
+		size_t page = (size_t)sysconf(_SC_PAGESIZE);
+		munmap(store->input, (store->inputSize / page + 1) * page);
+	} else {
+		free(store->input);
+	}
+	store->input = NULL;
+	store->inputSize = 0;
+}
+
+// Frees every record at once by releasing the arena chunks
+void freeStore(struct RecordStore *store) {
+	RecordChunk *chunk = store->chunks;
+	while (chunk != NULL) {
+		RecordChunk *next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	storeDropInput(store);
+	initStore(store);
+}
@@ -0,0 +1,47 @@
+// Bennett Taylor betaylor
+#ifndef RECORDS
+#define RECORDS
+
+#include <stddef.h>
+#include "mylist.h"
+
+// Number of records whose mirrors and sequences are computed together
+#define RECORD_BATCH 1024
+
+// One arena chunk, records are bump allocated from data
+typedef struct RecordChunk {
+	struct RecordChunk *next;
+	size_t used;
+	size_t size;
+	char data[];
+} RecordChunk;
+
+// Arena backed record store, nodes are bump allocated from its chunks
+typedef struct RecordStore {
+	RecordChunk *chunks;
+	// Input text while it is parsed, NUL terminated one byte past the end
+	char *input;
+	size_t inputSize;
+	int inputMapped;
+	struct Node *head;
+	struct Node *tail;
+	size_t count;
+	size_t bytes;
+	// Nodes waiting for their mirror and sequence count
+	struct Node *pending[RECORD_BATCH];
+	size_t pendingCount;
+	// Seconds spent computing mirrors and sequence counts
+	double computeSeconds;
+} RecordStore;
+
+// Function declarations
+void initStore(struct RecordStore *);
+const char *parseLine(const char *, const char *, unsigned int *);
+int storeMapFile(struct RecordStore *, const char *);
+int storeParse(struct RecordStore *, const char *, const char *);
+struct Node *storeAppend(struct RecordStore *, unsigned int);
+void storeDropInput(struct RecordStore *);
+struct Node *storeList(struct RecordStore *);
+void freeStore(struct RecordStore *);
+
+#endif
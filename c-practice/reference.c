@@ -0,0 +1,95 @@
+// Bennett Taylor betaylor
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One record of the straightforward implementation used to check MyBitApp
+typedef struct Reference {
+	char mirrorASCII[12];
+	unsigned int sequences;
+} Reference;
+
+// The original bit-by-bit loops, kept here so the check does not share any
+// code with the optimized kernels in bits.c and pattern.c
+static unsigned int referenceMirror(unsigned int input) {
+	unsigned int bound = sizeof(unsigned int) * 8;
+	unsigned int mirror = 0;
+	for (unsigned int index = 0; index < bound; index++) {
+		if (input & (1U << index)) {
+			mirror += (1U << (bound - index - 1));
+		}
+	}
+	return mirror;
+}
+
+// Counts the 010 bit pattern at every position, overlaps included
+static unsigned int referenceCount(unsigned int input) {
+	unsigned int bound = sizeof(unsigned int) * 8;
+	unsigned int count = 0;
+	for (unsigned int index = 0; index < bound - 2; index++) {
+		int bit1 = (input & (1U << index)) != 0;
+		int bit2 = (input & (1U << (index + 1))) != 0;
+		int bit3 = (input & (1U << (index + 2))) != 0;
+		if (!bit1 && bit2 && !bit3) {
+			count++;
+		}
+	}
+	return count;
+}
+
+static int compareReferences(const void *a, const void *b) {
+	return strcmp(((const Reference *)a)->mirrorASCII, ((const Reference *)b)->mirrorASCII);
+}
+
+// Sorts with strcmp on the mirror strings, the way MyBitApp is specified,
+// and writes the expected output
+int main(int argc, char *argv[]) {
+	if (argc != 3) {
+		printf("ERROR: Enter arguements for input and output files\n");
+		return 1;
+	}
+	FILE *in = fopen(argv[1], "r");
+	if (in == NULL) {
+		perror(argv[1]);
+		return 1;
+	}
+
+	size_t count = 0;
+	size_t capacity = 1024;
+	Reference *records = (Reference *)malloc(capacity * sizeof(Reference));
+	char line[64];
+	while (records != NULL && fgets(line, sizeof(line), in) != NULL) {
+		if (count == capacity) {
+			capacity *= 2;
+			Reference *grown = (Reference *)realloc(records, capacity * sizeof(Reference));
+			if (grown == NULL) {
+				free(records);
+			}
+			records = grown;
+			if (records == NULL) {
+				break;
+			}
+		}
+		unsigned int num = (unsigned int)strtoul(line, NULL, 10);
+		sprintf(records[count].mirrorASCII, "%u", referenceMirror(num));
+		records[count].sequences = referenceCount(num);
+		count++;
+	}
+	fclose(in);
+	if (records == NULL) {
+		printf("ERROR: Out of memory\n");
+		return 1;
+	}
+
+	qsort(records, count, sizeof(Reference), compareReferences);
+	FILE *out = fopen(argv[2], "w");
+	if (out == NULL) {
+		perror(argv[2]);
+		return 1;
+	}
+	for (size_t index = 0; index < count; index++) {
+		fprintf(out, "%s\t%d\n", records[index].mirrorASCII, records[index].sequences);
+	}
+	free(records);
+	return fclose(out) != 0;
+}
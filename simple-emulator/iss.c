@@ -0,0 +1,610 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include "iss.h"
+#include "memtrace.h"
+
+void iss_default_options(iss_options *options) {
+    memset(options, 0, sizeof(*options));
+    options->level = ISS_LEVEL_STATS;
+    ooo_default_config(&options->ooo_config);
+    mem_default_config(&options->mem);
+}
+
+/* Positive integer option value */
+static int option_value(int argc, char *argv[], int index, unsigned *value, FILE *err) {
+    char *end;
+    if (index + 1 >= argc) {
+        fprintf(err, "Error: %s needs a value\n", argv[index]);
+        return -1;
+    }
+    unsigned long parsed = strtoul(argv[index + 1], &end, 10);
+    if (*argv[index + 1] == '\0' || *end != '\0' || parsed == 0 || parsed > 1000000) {
+        fprintf(err, "Error: bad value for %s: %s\n", argv[index], argv[index + 1]);
+        return -1;
+    }
+    *value = (unsigned)parsed;
+    return 2;
+}
+
+/* Budget option value, anything up to the width of the counters */
+static int budget_value(int argc, char *argv[], int index, unsigned *value, FILE *err) {
+    char *end;
+    if (index + 1 >= argc) {
+        fprintf(err, "Error: %s needs a value\n", argv[index]);
+        return -1;
+    }
+    errno = 0;
+    unsigned long long parsed = strtoull(argv[index + 1], &end, 10);
+    if (*argv[index + 1] == '\0' || *end != '\0' || errno || parsed == 0 || parsed > UINT_MAX) {
+        fprintf(err, "Error: bad value for %s: %s\n", argv[index], argv[index + 1]);
+        return -1;
+    }
+    *value = (unsigned)parsed;
+    return 2;
+}
+
+int iss_parse_option(iss_options *options, int argc, char *argv[], int index, FILE *err) {
+    const char *arg = argv[index];
+
+    /* Instrumentation level */
+    if (strcmp(arg, "--level") == 0) {
+        const char *value = index + 1 < argc ? argv[index + 1] : "";
+        if (strcmp(value, "functional") == 0) {
+            options->level = ISS_LEVEL_FUNCTIONAL;
+        } else if (strcmp(value, "stats") == 0) {
+            options->level = ISS_LEVEL_STATS;
+        } else if (strcmp(value, "trace") == 0) {
+            options->level = ISS_LEVEL_TRACE;
+        } else {
+            fprintf(err, "Error: --level must be functional, stats or trace\n");
+            return -1;
+        }
+        return 2;
+    }
+    if (strcmp(arg, "--trace") == 0) {
+        if (index + 1 >= argc) {
+            fprintf(err, "Error: %s needs a value\n", arg);
+            return -1;
+        }
+        options->level = ISS_LEVEL_TRACE;
+        options->trace_path = argv[index + 1];
+        return 2;
+    }
+
+    /* Local memory timing and address stream recording */
+    if (strcmp(arg, "--mem") == 0) {
+        if (index + 1 >= argc) {
+            fprintf(err, "Error: %s needs a value\n", arg);
+            return -1;
+        }
+        return mem_parse_config(argv[index + 1], &options->mem, err) ? 2 : -1;
+    }
+    if (strcmp(arg, "--record-mem") == 0) {
+        if (index + 1 >= argc) {
+            fprintf(err, "Error: %s needs a value\n", arg);
+            return -1;
+        }
+        options->level = ISS_LEVEL_TRACE;
+        options->record_path = argv[index + 1];
+        return 2;
+    }
+
+    /* Runaway program protection */
+    if (strcmp(arg, "--max-instructions") == 0) {
+        return budget_value(argc, argv, index, &options->max_instructions, err);
+    }
+    if (strcmp(arg, "--max-cycles") == 0) {
+        return budget_value(argc, argv, index, &options->max_cycles, err);
+    }
+    if (strcmp(arg, "--detect-loops") == 0) {
+        options->detect_loops = true;
+        return 1;
+    }
+
+    /* Out-of-order timing model, setting any of its sizes enables it */
+    if (strcmp(arg, "--ooo") == 0) {
+        options->ooo = true;
+        return 1;
+    }
+    unsigned *field = NULL;
+    if (strcmp(arg, "--issue-width") == 0) {
+        field = &options->ooo_config.issue_width;
+    } else if (strcmp(arg, "--rob") == 0) {
+        field = &options->ooo_config.rob_size;
+    } else if (strcmp(arg, "--lsq") == 0) {
+        field = &options->ooo_config.lsq_size;
+    } else if (strcmp(arg, "--phys-regs") == 0) {
+        field = &options->ooo_config.phys_regs;
+    }
+    if (field) {
+        options->ooo = true;
+        return option_value(argc, argv, index, field, err);
+    }
+    return 0;
+}
+
+void iss_parse(FILE *file, iss_program *program, FILE *out) {
+    char *line = NULL;
+    size_t len = 0;
+    ssize_t read;
+
+    /* Only slot 0 starts out invalid, undecoded slots decode as MOV R0, 0 */
+    memset(program, 0, sizeof(*program));
+    program->instruction[0] = OP_INVALID;
+
+    /* Read instruction data */
+    unsigned line_index = 0;
+    int instruction_address = 0;
+    while ((read = getline(&line, &len, file)) != -1) {
+        /* Get instruction address*/
+        char *token = strtok(line, "\t ,[]\n");
+        if (token) {
+            instruction_address = atoi(token);
+            if (instruction_address < 0 || instruction_address >= MEMORY_SIZE) {
+                fprintf(out, "Error: instruction address %d out of range\n", instruction_address);
+                break;
+            }
+            if (line_index == 0) {
+                program->first_instruction = instruction_address;
+            }
+        } else {
+            fprintf(out, "Error reading instruction address\n");
+            break;
+        }
+
+        /* Get instruction */
+        token = strtok(NULL, "\t ,[]\n");
+        if (!token) {
+            fprintf(out, "Error reading instruction\n");
+            break;
+        }
+        char *op = &program->instruction[instruction_address];
+        switch (token[0]) {
+            case 'M': // MOV
+                *op = OP_MOV;
+                break;
+            case 'A': // ADD
+                *op = OP_ADD;
+                break;
+            case 'C': // CMP
+                *op = OP_CMP;
+                program->r_type[instruction_address] = true;
+                break;
+            case 'J': // JE/JMP
+                if (token[1] == 'E') {
+                    *op = OP_JE;
+                } else {
+                    *op = OP_JMP;
+                }
+                break;
+            case 'L': // LD
+                *op = OP_LD;
+                program->r_type[instruction_address] = true;
+                break;
+            case 'S': // ST
+                *op = OP_ST;
+                program->r_type[instruction_address] = true;
+                break;
+            default: // Invalid instruction
+                *op = OP_INVALID;
+                break;
+        }
+
+        /* Get arguments */
+        token = strtok(NULL, "\t ,[]\n");
+        if (token) {
+            if (*op != OP_JE && *op != OP_JMP) {
+                program->arg1[instruction_address] = atoi(&token[1]);
+            } else {
+                program->arg1[instruction_address] = atoi(token);
+            }
+        } else {
+            fprintf(out, "Error reading arg1\n");
+            break;
+        }
+
+        if (*op != OP_JE && *op != OP_JMP) {
+            token = strtok(NULL, "\t ,[]\n");
+            if (token) {
+                if (token[0] == 'R') {
+                    program->arg2[instruction_address] = atoi(&token[1]);
+                    program->r_type[instruction_address] = true;
+                } else {
+                    program->arg2[instruction_address] = atoi(token);
+                }
+            } else {
+                fprintf(out, "Error reading arg2\n");
+                break;
+            }
+        }
+
+        line_index++;
+    }
+
+    free(line);
+}
+
+/* Register operand, out of range numbers fold onto the scratch slot */
+static inline int reg_index(char number) {
+    if (number < 1 || number > REGISTER_COUNT) {
+        return 0;
+    }
+    return number;
+}
+
+/* Local memory access, charges the miss penalty when the line isn't held */
+static inline void touch(mem_cache *cache, unsigned char index, iss_stats *stats, bool *miss) {
+    *miss = !mem_access(cache, index);
+    if (*miss) {
+        stats->cycle_count += cache->config.miss_penalty;
+    } else {
+        stats->cache_hits++;
+    }
+    stats->cycle_count += 1;
+    stats->memory_ops++;
+}
+
+/*
+ * Livelock detection. The machine is deterministic, so if its state at a
+ * loop back-edge ever repeats it will loop forever. Memory is folded into a
+ * checksum that every store updates in O(1), and the back-edge states are
+ * checked with Brent's cycle finding, so only one saved state is kept. The
+ * saved state is compared in full on a hash match, collisions can't stop a
+ * healthy program.
+ */
+typedef struct {
+    uint64_t memory_sum;
+    uint64_t saved_hash;
+    unsigned saved_instructions;
+    unsigned long long power, steps;
+    int saved_pc;
+    char saved_registers[REGISTER_COUNT + 1];
+    bool saved_flag;
+    char saved_data[MEMORY_SIZE];
+} loop_check;
+
+/* Contribution of one memory byte to the checksum, zero bytes add nothing */
+static inline uint64_t memory_term(unsigned char address, char value) {
+    uint64_t x = ((uint64_t)address << 8 | (unsigned char)value) * 0x9E3779B97F4A7C15ULL;
+    return value ? x ^ (x >> 29) : 0;
+}
+
+static uint64_t state_hash(const iss_machine *machine, const loop_check *check, int pc) {
+    uint64_t x = machine->equal_flag;
+    for (int i = 0; i <= REGISTER_COUNT; i++) {
+        x = x << 8 | (unsigned char)machine->registers[i];
+    }
+    x ^= check->memory_sum ^ ((uint64_t)pc << 56);
+    x *= 0xBF58476D1CE4E5B9ULL;
+    return x ^ (x >> 31);
+}
+
+static void loop_save(loop_check *check, const iss_machine *machine, uint64_t hash, int pc, unsigned instructions) {
+    check->saved_hash = hash;
+    check->saved_pc = pc;
+    check->saved_instructions = instructions;
+    check->saved_flag = machine->equal_flag;
+    memcpy(check->saved_registers, machine->registers, sizeof(check->saved_registers));
+    memcpy(check->saved_data, machine->data, sizeof(check->saved_data));
+}
+
+/* Returns true if the state about to enter pc was already seen there */
+static bool loop_repeats(loop_check *check, const iss_machine *machine, int pc, unsigned instructions) {
+    uint64_t hash = state_hash(machine, check, pc);
+    if (check->power == 0) {
+        check->power = 1;
+        loop_save(check, machine, hash, pc, instructions);
+        return false;
+    }
+    if (hash == check->saved_hash && pc == check->saved_pc &&
+        machine->equal_flag == check->saved_flag &&
+        memcmp(machine->registers, check->saved_registers, sizeof(check->saved_registers)) == 0 &&
+        memcmp(machine->data, check->saved_data, sizeof(check->saved_data)) == 0) {
+        return true;
+    }
+    if (++check->steps == check->power) {
+        check->power *= 2;
+        check->steps = 0;
+        loop_save(check, machine, hash, pc, instructions);
+    }
+    return false;
+}
+
+/* Mnemonics for trace output, indexed by opcode */
+static const char *const mnemonics[] = { "MOV", "ADD", "CMP", "JE", "JMP", "LD", "ST" };
+
+/*
+ * Simulator core. Always inlined into each variant below with a constant
+ * instrumentation level and constant hook arguments, so the compiler drops
+ * every counter, hook and trace statement a variant doesn't use.
+ */
+#define STATS (level >= ISS_LEVEL_STATS)
+#define TRACE (level >= ISS_LEVEL_TRACE)
+
+static inline __attribute__((always_inline))
+void run_core(const iss_program *program, const iss_options *options, iss_stats *stats, FILE *err,
+              const iss_level level, ooo_model *timing, loop_check *check, FILE *trace,
+              mem_trace_writer *recorder) {
+    iss_machine machine;
+    char *registers = machine.registers;
+    memset(&machine, 0, sizeof(machine));
+    mem_cache cache;
+    if (STATS) {
+        mem_cache_init(&cache, &options->mem);
+    }
+    const unsigned max_instructions = options->max_instructions ? options->max_instructions : UINT_MAX;
+    const unsigned max_cycles = options->max_cycles ? options->max_cycles : UINT_MAX;
+
+    int instruction_address = program->first_instruction;
+
+    /* Run simulation */
+    bool running = true;
+    while (running) {
+        /* Fetching outside of memory faults like an invalid opcode */
+        if (instruction_address < 0 || instruction_address >= MEMORY_SIZE) {
+            fprintf(err, "Error: Invalid instruction at index %d\n", instruction_address);
+            if (STATS) {
+                stats->cycle_count += 1;
+                stats->instruction_count++;
+            }
+            break;
+        }
+        const char opcode = program->instruction[instruction_address];
+        if (opcode == OP_INVALID) {
+            break;
+        }
+
+        /* Budgets stop runaway programs before the next instruction */
+        if (STATS && stats->instruction_count >= max_instructions) {
+            fprintf(err, "Error: instruction budget of %u exhausted at index %d\n",
+                    max_instructions, instruction_address);
+            stats->stop = ISS_INSTRUCTION_BUDGET;
+            break;
+        }
+        if (STATS && stats->cycle_count >= max_cycles) {
+            fprintf(err, "Error: cycle budget of %u exhausted at index %d\n",
+                    max_cycles, instruction_address);
+            stats->stop = ISS_CYCLE_BUDGET;
+            break;
+        }
+        const int r1 = reg_index(program->arg1[instruction_address]);
+        const int r2 = reg_index(program->arg2[instruction_address]);
+        const char a1 = program->arg1[instruction_address];
+        const char a2 = program->arg2[instruction_address];
+        ooo_event event = { opcode, -1, -1, -1, false, false, false, false, 0 };
+        const int pc = instruction_address;
+        const unsigned start_cycle = stats->cycle_count;
+
+        switch (opcode) {
+            case OP_MOV:
+                registers[r1] = a2;
+                event.dest = r1;
+                break;
+            case OP_ADD:
+                if (program->r_type[instruction_address]) {
+                    registers[r1] += registers[r2];
+                    event.src2 = r2;
+                } else {
+                    registers[r1] += a2;
+                }
+                event.dest = event.src1 = r1;
+                break;
+            case OP_CMP:
+                machine.equal_flag = (registers[r1] == registers[r2]);
+                event.src1 = r1;
+                event.src2 = r2;
+                event.flag_write = true;
+                break;
+            case OP_JE:
+                event.flag_read = true;
+                if (machine.equal_flag) {
+                    instruction_address = a1 - 1;
+                    machine.equal_flag = false;
+                    event.flag_write = true;
+                }
+                break;
+            case OP_JMP:
+                instruction_address = a1 - 1;
+                break;
+            case OP_LD:
+                event.address = (unsigned char)registers[r2];
+                if (STATS) {
+                    touch(&cache, event.address, stats, &event.miss);
+                }
+                if (TRACE && recorder) {
+                    mem_trace_record(recorder, event.address, false);
+                }
+                registers[r1] = machine.data[event.address];
+                event.dest = r1;
+                event.src1 = r2;
+                event.memory = true;
+                break;
+            case OP_ST:
+                event.address = (unsigned char)registers[r1];
+                if (STATS) {
+                    touch(&cache, event.address, stats, &event.miss);
+                }
+                if (TRACE && recorder) {
+                    mem_trace_record(recorder, event.address, true);
+                }
+                if (check) {
+                    check->memory_sum ^= memory_term(event.address, machine.data[event.address]) ^
+                                         memory_term(event.address, registers[r2]);
+                }
+                machine.data[event.address] = registers[r2];
+                event.src1 = r1;
+                event.src2 = r2;
+                event.memory = true;
+                break;
+            default: // Invalid instruction
+                fprintf(err, "Error: Invalid instruction at index %d\n", instruction_address);
+                running = false;
+                break;
+        }
+        if (timing && running) {
+            ooo_step(timing, &event);
+        }
+        if (STATS) {
+            stats->cycle_count += 1;
+            stats->instruction_count++;
+        }
+        if (TRACE) {
+            stats->executions[pc]++;
+            stats->pc_cycles[pc] += stats->cycle_count - start_cycle;
+            if (trace && running) {
+                fprintf(trace, "%u\t%d\t%s\tR1=%d R2=%d R3=%d R4=%d R5=%d R6=%d flag=%d cycles=%u\n",
+                        stats->instruction_count, pc, mnemonics[(int)opcode],
+                        registers[1], registers[2], registers[3], registers[4], registers[5], registers[6],
+                        machine.equal_flag, stats->cycle_count);
+            }
+        }
+        instruction_address++;
+
+        /* Taken branches to the same or an earlier address close a loop */
+        if (check && instruction_address <= pc &&
+            loop_repeats(check, &machine, instruction_address, stats->instruction_count)) {
+            fprintf(err, "Error: livelock detected at index %d, machine state repeats every %u instructions\n",
+                    instruction_address, stats->instruction_count - check->saved_instructions);
+            stats->stop = ISS_LIVELOCK;
+            break;
+        }
+    }
+
+    memcpy(stats->registers, &registers[1], REGISTER_COUNT);
+    stats->equal_flag = machine.equal_flag;
+}
+
+#undef STATS
+#undef TRACE
+
+/*
+ * Specialized variants, one per instrumentation level and hook combination,
+ * picked once per run so the instruction loop never tests for them.
+ */
+typedef void (*run_variant)(const iss_program *, const iss_options *, iss_stats *, FILE *,
+                            ooo_model *, loop_check *, FILE *, mem_trace_writer *);
+
+#define RUN_VARIANT(name, level, timed, looped)                                          \
+    static void name(const iss_program *program, const iss_options *options,            \
+                     iss_stats *stats, FILE *err, ooo_model *timing, loop_check *check,  \
+                     FILE *trace, mem_trace_writer *recorder) {                          \
+        (void)timing;                                                                    \
+        (void)check;                                                                     \
+        (void)trace;                                                                     \
+        (void)recorder;                                                                  \
+        run_core(program, options, stats, err, level, timed ? timing : NULL,            \
+                 looped ? check : NULL, level >= ISS_LEVEL_TRACE ? trace : NULL,         \
+                 level >= ISS_LEVEL_TRACE ? recorder : NULL);                           \
+    }
+
+RUN_VARIANT(run_functional, ISS_LEVEL_FUNCTIONAL, false, false)
+RUN_VARIANT(run_stats, ISS_LEVEL_STATS, false, false)
+RUN_VARIANT(run_stats_loops, ISS_LEVEL_STATS, false, true)
+RUN_VARIANT(run_stats_ooo, ISS_LEVEL_STATS, true, false)
+RUN_VARIANT(run_stats_ooo_loops, ISS_LEVEL_STATS, true, true)
+RUN_VARIANT(run_trace, ISS_LEVEL_TRACE, false, false)
+RUN_VARIANT(run_trace_loops, ISS_LEVEL_TRACE, false, true)
+RUN_VARIANT(run_trace_ooo, ISS_LEVEL_TRACE, true, false)
+RUN_VARIANT(run_trace_ooo_loops, ISS_LEVEL_TRACE, true, true)
+
+/* Indexed by [level][timing model][loop detector] */
+static const run_variant variants[3][2][2] = {
+    { { run_functional, run_functional }, { run_functional, run_functional } },
+    { { run_stats, run_stats_loops }, { run_stats_ooo, run_stats_ooo_loops } },
+    { { run_trace, run_trace_loops }, { run_trace_ooo, run_trace_ooo_loops } },
+};
+
+bool iss_run(const iss_program *program, const iss_options *options, iss_stats *stats, FILE *err) {
+    /* The profile is only written, and so only cleared, at the trace level */
+    if (options->level >= ISS_LEVEL_TRACE) {
+        memset(stats, 0, sizeof(*stats));
+    } else {
+        memset(stats, 0, offsetof(iss_stats, executions));
+    }
+    if (options->level == ISS_LEVEL_FUNCTIONAL &&
+        (options->ooo || options->detect_loops || options->max_instructions || options->max_cycles)) {
+        fprintf(err, "Error: budgets, --detect-loops and --ooo need --level stats or trace\n");
+        return false;
+    }
+
+    FILE *trace = NULL;
+    if (options->trace_path) {
+        trace = fopen(options->trace_path, "w");
+        if (!trace) {
+            fprintf(err, "Failed to open trace file: %s\n", strerror(errno));
+            return false;
+        }
+    }
+
+    mem_trace_writer recorder;
+    if (options->record_path && !mem_trace_create(&recorder, options->record_path, err)) {
+        if (trace) fclose(trace);
+        return false;
+    }
+
+    /* Timing model driven by the functional execution stream */
+    ooo_model *timing = NULL;
+    if (options->ooo) {
+        ooo_config config = options->ooo_config;
+        config.miss_penalty = options->mem.miss_penalty;
+        timing = ooo_create(&config, err);
+        if (!timing) {
+            if (trace) fclose(trace);
+            if (options->record_path) mem_trace_close(&recorder, 0);
+            return false;
+        }
+    }
+
+    loop_check check = {0};
+    variants[options->level][timing != NULL][options->detect_loops](program, options, stats, err,
+                                                                    timing, &check, trace,
+                                                                    options->record_path ? &recorder : NULL);
+    bool ok = true;
+    if (timing) {
+        ooo_finish(timing, &stats->ooo);
+        ooo_destroy(timing);
+    }
+    if (trace) {
+        fclose(trace);
+    }
+    if (options->record_path && !mem_trace_close(&recorder, stats->instruction_count)) {
+        fprintf(err, "Error: failed to write memory trace %s\n", options->record_path);
+        ok = false;
+    }
+    return ok;
+}
+
+void iss_print_stats(FILE *out, const iss_options *options, const iss_stats *stats) {
+    /* Without statistics the final machine state is the only result */
+    if (options->level == ISS_LEVEL_FUNCTIONAL) {
+        fprintf(out, "Final registers:");
+        for (int i = 0; i < REGISTER_COUNT; i++) {
+            fprintf(out, " R%d=%d", i + 1, stats->registers[i]);
+        }
+        fprintf(out, " flag=%d\n", stats->equal_flag);
+        return;
+    }
+
+    fprintf(out, "Total number of executed instructions: %u\n", stats->instruction_count);
+    fprintf(out, "Total number of clock cycles: %u\n", stats->cycle_count);
+    fprintf(out, "Number of hits to local memory: %u\n", stats->cache_hits);
+    fprintf(out, "Total number of executed LD/ST instructions: %u\n", stats->memory_ops);
+    if (options->ooo) {
+        ooo_print_stats(out, &options->ooo_config, &stats->ooo);
+    }
+    if (options->level >= ISS_LEVEL_TRACE) {
+        fprintf(out, "Total number of memory clock cycles: %u\n",
+                mem_cycles(&options->mem, stats->memory_ops, stats->cache_hits));
+        fprintf(out, "Profile (address: executions, clock cycles):\n");
+        for (int i = 0; i < MEMORY_SIZE; i++) {
+            if (stats->executions[i]) {
+                fprintf(out, "%3d: %u, %u\n", i, stats->executions[i], stats->pc_cycles[i]);
+            }
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef ISS_H
+#define ISS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "ooo.h"
+#include "memmodel.h"
+
+#define MEMORY_SIZE 256
+#define REGISTER_COUNT 6
+
+/* Opcodes stored in the decoded instruction array */
+#define OP_INVALID -1
+#define OP_MOV 0
+#define OP_ADD 1
+#define OP_CMP 2
+#define OP_JE 3
+#define OP_JMP 4
+#define OP_LD 5
+#define OP_ST 6
+
+/* Decoded program, indexed by instruction address */
+typedef struct {
+    char instruction[MEMORY_SIZE];
+    char arg1[MEMORY_SIZE];
+    char arg2[MEMORY_SIZE];
+    bool r_type[MEMORY_SIZE];
+    int first_instruction;
+} iss_program;
+
+/* Machine state for a single run */
+typedef struct {
+    /* Memory data */
+    char data[MEMORY_SIZE];
+
+    /* Register data, R1..R6 live at index 1..6 and index 0 is a scratch
+     * slot that absorbs writes from undecoded (zeroed) instruction slots */
+    char registers[REGISTER_COUNT + 1];
+    bool equal_flag;
+} iss_machine;
+
+/* Instrumentation compiled into the simulator core variant */
+typedef enum {
+    ISS_LEVEL_FUNCTIONAL,   /* machine state only, no counters */
+    ISS_LEVEL_STATS,        /* instruction, cycle and memory counters */
+    ISS_LEVEL_TRACE,        /* counters, per-address profile and optional trace */
+} iss_level;
+
+/* Run options, shared by the command line and daemon jobs */
+typedef struct {
+    iss_level level;
+    const char *trace_path;     /* per-instruction trace, NULL for none */
+    const char *record_path;    /* LD/ST address trace, NULL for none */
+    mem_config mem;
+    unsigned max_instructions;  /* 0 for no limit */
+    unsigned max_cycles;        /* 0 for no limit */
+    bool detect_loops;
+    bool ooo;
+    ooo_config ooo_config;
+} iss_options;
+
+/* Why a run stopped */
+typedef enum {
+    ISS_HALTED,             /* reached an invalid opcode or left memory */
+    ISS_INSTRUCTION_BUDGET,
+    ISS_CYCLE_BUDGET,
+    ISS_LIVELOCK,           /* machine state repeated at a loop back-edge */
+} iss_stop;
+
+/* Statistics */
+typedef struct {
+    unsigned instruction_count;
+    unsigned cycle_count;
+    unsigned cache_hits;
+    unsigned memory_ops;
+    iss_stop stop;
+    ooo_stats ooo;
+    char registers[REGISTER_COUNT];
+    bool equal_flag;
+
+    /* Trace level profile, left untouched by the other levels */
+    unsigned executions[MEMORY_SIZE];
+    unsigned pc_cycles[MEMORY_SIZE];
+} iss_stats;
+
+void iss_default_options(iss_options *options);
+
+/* Parse the run option at argv[index], returns the number of arguments used,
+ * 0 if argv[index] is not a run option and -1 if its value is bad */
+int iss_parse_option(iss_options *options, int argc, char *argv[], int index, FILE *err);
+
+/* Decode an assembly listing, reporting parse errors to out */
+void iss_parse(FILE *file, iss_program *program, FILE *out);
+
+/* Run a decoded program from a fresh machine state, reporting faults to err.
+ * Returns false if the options could not be applied. */
+bool iss_run(const iss_program *program, const iss_options *options, iss_stats *stats, FILE *err);
+
+/* Print statistics in the myISS report format */
+void iss_print_stats(FILE *out, const iss_options *options, const iss_stats *stats);
+
+/* Unix-domain socket daemon and thin client (iss_server.c) */
+int iss_serve(const char *socket_path, unsigned workers, unsigned cache_entries);
+int iss_client(const char *socket_path, int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,612 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "iss.h"
+
+/*
+ * Resident simulation daemon.
+ *
+ * Protocol (one job per request, any number of jobs per connection):
+ *   client -> server   ARG <option>          zero or more run options
+ *                      PATH <absolute path>  program read by the server
+ *                      TEXT <bytes>\n<data>  inline program text
+ *   server -> client   1 <line>              line for stdout
+ *                      2 <line>              line for stderr
+ *                      EXIT <status>         end of job
+ *
+ * A job's stderr lines are sent before its stdout lines. The client writes
+ * each channel to its own stream, so the two streams match a local run but
+ * a merged view (2>&1) is ordered differently. A job with more than MAX_ARGS
+ * options fails with an error. A TEXT length that is not a number or is
+ * above MAX_TEXT is answered with an error and the connection is closed,
+ * since the data that follows it cannot be skipped safely. --trace and
+ * --record-mem paths must be absolute; the client resolves relative ones
+ * against its own working directory before sending them.
+ */
+
+#define CACHE_BUCKETS 256
+#define QUEUE_SIZE 64
+#define MAX_ARGS 64
+#define MAX_TEXT (16UL << 20)
+
+/* Decoded program cache entry, keyed by a hash of the program text */
+typedef struct cache_entry {
+    uint64_t hash;
+    char *text;
+    size_t len;
+    iss_program program;
+    char *diagnostics;
+    size_t diagnostics_len;
+    unsigned refs;
+    bool cached;
+    struct cache_entry *chain;
+    struct cache_entry *prev, *next;
+} cache_entry;
+
+/* Program cache, buckets for lookup and a list in LRU order */
+static struct {
+    pthread_mutex_t lock;
+    cache_entry *buckets[CACHE_BUCKETS];
+    cache_entry *head, *tail;
+    unsigned count, capacity;
+    unsigned long hits, misses;
+} cache = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/* Accepted connections waiting for a worker */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty, not_full;
+    int fds[QUEUE_SIZE];
+    unsigned head, count;
+} queue = { .lock = PTHREAD_MUTEX_INITIALIZER, .not_empty = PTHREAD_COND_INITIALIZER, .not_full = PTHREAD_COND_INITIALIZER };
+
+static const char *listen_path = NULL;
+
+/* FNV-1a over the program text */
+static uint64_t hash_text(const char *text, size_t len) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void lru_unlink(cache_entry *entry) {
+    if (entry->prev) entry->prev->next = entry->next; else cache.head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev; else cache.tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void lru_push_front(cache_entry *entry) {
+    entry->next = cache.head;
+    entry->prev = NULL;
+    if (cache.head) cache.head->prev = entry; else cache.tail = entry;
+    cache.head = entry;
+}
+
+static void entry_free(cache_entry *entry) {
+    free(entry->text);
+    free(entry->diagnostics);
+    free(entry);
+}
+
+/* Drop least recently used entries that no job is holding */
+static void cache_evict(void) {
+    cache_entry *entry = cache.tail;
+    while (cache.count > cache.capacity && entry) {
+        cache_entry *prev = entry->prev;
+        if (entry->refs == 0) {
+            cache_entry **link = &cache.buckets[entry->hash % CACHE_BUCKETS];
+            while (*link != entry) link = &(*link)->chain;
+            *link = entry->chain;
+            lru_unlink(entry);
+            cache.count--;
+            entry_free(entry);
+        }
+        entry = prev;
+    }
+}
+
+/* Look up a program by its text, decoding and inserting it on a miss.
+ * Takes ownership of text and returns a referenced entry, or NULL when
+ * there is no memory to decode it. */
+static cache_entry *cache_acquire(char *text, size_t len) {
+    uint64_t hash = hash_text(text, len);
+    cache_entry *entry;
+
+    pthread_mutex_lock(&cache.lock);
+    for (entry = cache.buckets[hash % CACHE_BUCKETS]; entry; entry = entry->chain) {
+        if (entry->hash == hash && entry->len == len && memcmp(entry->text, text, len) == 0) {
+            entry->refs++;
+            lru_unlink(entry);
+            lru_push_front(entry);
+            cache.hits++;
+            pthread_mutex_unlock(&cache.lock);
+            free(text);
+            return entry;
+        }
+    }
+    cache.misses++;
+    pthread_mutex_unlock(&cache.lock);
+
+    /* Decode outside of the lock, keeping parse errors for replay */
+    entry = calloc(1, sizeof(*entry));
+    if (!entry) {
+        free(text);
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->text = text;
+    entry->len = len;
+    entry->refs = 1;
+    FILE *in = fmemopen(text, len, "r");
+    FILE *diag = open_memstream(&entry->diagnostics, &entry->diagnostics_len);
+    if (!in || !diag) {
+        if (in) fclose(in);
+        if (diag) fclose(diag);
+        free(entry->diagnostics);
+        free(text);
+        free(entry);
+        return NULL;
+    }
+    iss_parse(in, &entry->program, diag);
+    fclose(diag);
+    fclose(in);
+
+    pthread_mutex_lock(&cache.lock);
+    if (cache.capacity > 0) {
+        entry->cached = true;
+        entry->chain = cache.buckets[hash % CACHE_BUCKETS];
+        cache.buckets[hash % CACHE_BUCKETS] = entry;
+        lru_push_front(entry);
+        cache.count++;
+        cache_evict();
+    }
+    pthread_mutex_unlock(&cache.lock);
+    return entry;
+}
+
+static void cache_release(cache_entry *entry) {
+    pthread_mutex_lock(&cache.lock);
+    entry->refs--;
+    if (!entry->cached) {
+        entry_free(entry);
+    } else {
+        cache_evict();
+    }
+    pthread_mutex_unlock(&cache.lock);
+}
+
+/* Forward captured output line by line on the given channel */
+static void send_lines(FILE *sock, int channel, const char *buf, size_t len) {
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] == '\n') {
+            fprintf(sock, "%d %.*s\n", channel, (int)(i - start), &buf[start]);
+            start = i + 1;
+        }
+    }
+    if (start < len) {
+        fprintf(sock, "%d %.*s\n", channel, (int)(len - start), &buf[start]);
+    }
+}
+
+static void send_exit(FILE *sock, int status) {
+    fprintf(sock, "EXIT %d\n", status);
+    fflush(sock);
+}
+
+/* Read a whole program file into memory */
+static char *read_file(const char *path, size_t *len) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+    char *text = NULL;
+    FILE *copy = open_memstream(&text, len);
+    if (!copy) {
+        fclose(file);
+        return NULL;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+        fwrite(buf, 1, n, copy);
+    }
+    bool failed = ferror(file) || ferror(copy);
+    if (fclose(copy) != 0) {
+        failed = true;
+    }
+    fclose(file);
+    if (failed) {
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+static void free_args(char *args[], int *count) {
+    for (int i = 0; i < *count; i++) {
+        free(args[i]);
+    }
+    *count = 0;
+}
+
+/* Serve jobs on one connection until the client hangs up */
+static void handle_connection(int fd) {
+    FILE *in = fdopen(fd, "r");
+    if (!in) {
+        close(fd);
+        return;
+    }
+    int out_fd = dup(fd);
+    FILE *sock = out_fd < 0 ? NULL : fdopen(out_fd, "w");
+    if (!sock) {
+        if (out_fd >= 0) close(out_fd);
+        fclose(in);
+        return;
+    }
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t read;
+    char *args[MAX_ARGS];
+    int arg_count = 0;
+    bool too_many_args = false;
+    bool lost_args = false;
+
+    while ((read = getline(&line, &cap, in)) != -1) {
+        if (read > 0 && line[read - 1] == '\n') {
+            line[--read] = '\0';
+        }
+
+        char *text = NULL;
+        size_t len = 0;
+        if (strncmp(line, "ARG ", 4) == 0) {
+            /* Run options are collected until the program arrives */
+            if (arg_count < MAX_ARGS) {
+                args[arg_count] = strdup(&line[4]);
+                if (args[arg_count]) {
+                    arg_count++;
+                } else {
+                    lost_args = true;
+                }
+            } else {
+                too_many_args = true;
+            }
+            continue;
+        } else if (strncmp(line, "PATH ", 5) == 0) {
+            text = read_file(&line[5], &len);
+            if (!text) {
+                char msg[PATH_MAX + 64];
+                int n = snprintf(msg, sizeof(msg), "Failed to open file: %s", strerror(errno));
+                send_lines(sock, 2, msg, n);
+                send_exit(sock, EXIT_FAILURE);
+                free_args(args, &arg_count);
+                too_many_args = false;
+                lost_args = false;
+                continue;
+            }
+        } else if (strncmp(line, "TEXT ", 5) == 0) {
+            char *end = NULL;
+            errno = 0;
+            unsigned long long requested = strtoull(&line[5], &end, 10);
+            if (errno != 0 || end == &line[5] || *end != '\0' || line[5] == '-' || requested > MAX_TEXT) {
+                char msg[96];
+                int n = snprintf(msg, sizeof(msg), "Error: program text must be a length of at most %lu bytes", MAX_TEXT);
+                send_lines(sock, 2, msg, n);
+                send_exit(sock, EXIT_FAILURE);
+                break;
+            }
+            len = requested;
+            text = malloc(len + 1);
+            if (!text) {
+                send_lines(sock, 2, "Error: out of memory", 20);
+                send_exit(sock, EXIT_FAILURE);
+                break;
+            }
+            if (fread(text, 1, len, in) != len) {
+                free(text);
+                break;
+            }
+            text[len] = '\0';
+        } else {
+            send_lines(sock, 2, "Error: malformed request", 24);
+            send_exit(sock, EXIT_FAILURE);
+            continue;
+        }
+
+        /* Apply the job's run options with the command line parser */
+        iss_options options;
+        int status = EXIT_SUCCESS;
+        char *out_buf = NULL, *err_buf = NULL;
+        size_t out_len = 0, err_len = 0;
+        FILE *out = open_memstream(&out_buf, &out_len);
+        FILE *err = open_memstream(&err_buf, &err_len);
+        if (!out || !err) {
+            if (out) fclose(out);
+            if (err) fclose(err);
+            free(out_buf);
+            free(err_buf);
+            free(text);
+            free_args(args, &arg_count);
+            too_many_args = false;
+            lost_args = false;
+            send_lines(sock, 2, "Error: out of memory", 20);
+            send_exit(sock, EXIT_FAILURE);
+            continue;
+        }
+        iss_default_options(&options);
+        if (too_many_args) {
+            fprintf(err, "Error: more than %d run options\n", MAX_ARGS);
+            status = EXIT_FAILURE;
+        } else if (lost_args) {
+            fprintf(err, "Error: out of memory\n");
+            status = EXIT_FAILURE;
+        }
+        for (int i = 0; i < arg_count && status == EXIT_SUCCESS;) {
+            int used = iss_parse_option(&options, arg_count, args, i, err);
+            if (used == 0) {
+                fprintf(err, "Error: unknown option %s\n", args[i]);
+            }
+            if (used <= 0) {
+                status = EXIT_FAILURE;
+            }
+            i += used;
+        }
+        /* Relative output paths would land in the server's working directory */
+        if (status == EXIT_SUCCESS && ((options.trace_path && options.trace_path[0] != '/') ||
+                                       (options.record_path && options.record_path[0] != '/'))) {
+            fprintf(err, "Error: output paths must be absolute in server mode\n");
+            status = EXIT_FAILURE;
+        }
+
+        /* Run the job against the cached decode, capturing its output */
+        if (status == EXIT_SUCCESS) {
+            cache_entry *entry = cache_acquire(text, len);
+            iss_stats stats;
+            if (!entry) {
+                fprintf(err, "Error: out of memory\n");
+                status = EXIT_FAILURE;
+            } else {
+                fwrite(entry->diagnostics, 1, entry->diagnostics_len, out);
+                if (iss_run(&entry->program, &options, &stats, err)) {
+                    iss_print_stats(out, &options, &stats);
+                    if (stats.stop != ISS_HALTED) {
+                        status = EXIT_FAILURE;
+                    }
+                } else {
+                    status = EXIT_FAILURE;
+                }
+                cache_release(entry);
+            }
+        } else {
+            free(text);
+        }
+        fclose(out);
+        fclose(err);
+        free_args(args, &arg_count);
+        too_many_args = false;
+        lost_args = false;
+
+        send_lines(sock, 2, err_buf, err_len);
+        send_lines(sock, 1, out_buf, out_len);
+        send_exit(sock, status);
+        free(out_buf);
+        free(err_buf);
+    }
+
+    free_args(args, &arg_count);
+    free(line);
+    fclose(sock);
+    fclose(in);
+}
+
+static void *worker(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == 0) {
+            pthread_cond_wait(&queue.not_empty, &queue.lock);
+        }
+        int fd = queue.fds[queue.head];
+        queue.head = (queue.head + 1) % QUEUE_SIZE;
+        queue.count--;
+        pthread_cond_signal(&queue.not_full);
+        pthread_mutex_unlock(&queue.lock);
+
+        handle_connection(fd);
+    }
+    return NULL;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    if (listen_path) {
+        unlink(listen_path);
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+int iss_serve(const char *socket_path, unsigned workers, unsigned cache_entries) {
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long\n");
+        return EXIT_FAILURE;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("Failed to create socket");
+        return EXIT_FAILURE;
+    }
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, QUEUE_SIZE) < 0) {
+        perror("Failed to listen on socket");
+        close(listen_fd);
+        return EXIT_FAILURE;
+    }
+    listen_path = socket_path;
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    cache.capacity = cache_entries;
+    for (unsigned i = 0; i < workers; i++) {
+        pthread_t thread;
+        int rc = pthread_create(&thread, NULL, worker, NULL);
+        if (rc != 0) {
+            fprintf(stderr, "Error: failed to start worker %u of %u: %s\n", i + 1, workers, strerror(rc));
+            close(listen_fd);
+            unlink(socket_path);
+            return EXIT_FAILURE;
+        }
+        pthread_detach(thread);
+    }
+
+    /* Hand accepted connections to the worker pool */
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("Failed to accept connection");
+            break;
+        }
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == QUEUE_SIZE) {
+            pthread_cond_wait(&queue.not_full, &queue.lock);
+        }
+        queue.fds[(queue.head + queue.count) % QUEUE_SIZE] = fd;
+        queue.count++;
+        pthread_cond_signal(&queue.not_empty);
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    return EXIT_FAILURE;
+}
+
+int iss_client(const char *socket_path, int argc, char *argv[]) {
+    const char *program_path = argv[argc - 1];
+    struct sockaddr_un addr;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long\n");
+        return EXIT_FAILURE;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("Failed to connect to server");
+        return EXIT_FAILURE;
+    }
+    FILE *sock = fdopen(fd, "r+");
+    if (!sock) {
+        perror("Failed to connect to server");
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    /* Run options are parsed by the server, which runs in its own working
+     * directory. The client parses them too, only to find the output paths
+     * and make relative ones absolute. Errors are left for the server. */
+    char cwd[PATH_MAX];
+    char *quiet_buf = NULL;
+    size_t quiet_len = 0;
+    FILE *quiet = open_memstream(&quiet_buf, &quiet_len);
+    if (!quiet || !getcwd(cwd, sizeof(cwd))) {
+        perror("Failed to resolve run options");
+        if (quiet) fclose(quiet);
+        free(quiet_buf);
+        fclose(sock);
+        return EXIT_FAILURE;
+    }
+    iss_options options;
+    iss_default_options(&options);
+    for (int i = 0; i < argc - 1;) {
+        int used = iss_parse_option(&options, argc - 1, argv, i, quiet);
+        if (used <= 0) {
+            used = 1;
+        }
+        for (int j = i; j < i + used; j++) {
+            bool output_path = j > i && (argv[j] == options.trace_path || argv[j] == options.record_path);
+            if (output_path && argv[j][0] != '/') {
+                fprintf(sock, "ARG %s/%s\n", cwd, argv[j]);
+            } else {
+                fprintf(sock, "ARG %s\n", argv[j]);
+            }
+        }
+        i += used;
+    }
+    fclose(quiet);
+    free(quiet_buf);
+
+    /* Send the program, "-" sends standard input inline */
+    if (strcmp(program_path, "-") == 0) {
+        char *text = NULL;
+        size_t len = 0;
+        FILE *copy = open_memstream(&text, &len);
+        if (!copy) {
+            perror("Failed to read standard input");
+            fclose(sock);
+            return EXIT_FAILURE;
+        }
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), stdin)) > 0) {
+            fwrite(buf, 1, n, copy);
+        }
+        if (ferror(stdin) | fclose(copy)) {
+            perror("Failed to read standard input");
+            free(text);
+            fclose(sock);
+            return EXIT_FAILURE;
+        }
+        fprintf(sock, "TEXT %zu\n", len);
+        fwrite(text, 1, len, sock);
+        free(text);
+    } else {
+        char resolved[PATH_MAX];
+        if (!realpath(program_path, resolved)) {
+            perror("Failed to open file");
+            fclose(sock);
+            return EXIT_FAILURE;
+        }
+        fprintf(sock, "PATH %s\n", resolved);
+    }
+    fflush(sock);
+
+    /* Replay the job output on the matching streams */
+    int status = EXIT_FAILURE;
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, sock) != -1) {
+        if (strncmp(line, "1 ", 2) == 0) {
+            fputs(&line[2], stdout);
+        } else if (strncmp(line, "2 ", 2) == 0) {
+            fputs(&line[2], stderr);
+        } else if (strncmp(line, "EXIT ", 5) == 0) {
+            status = atoi(&line[5]);
+            break;
+        }
+    }
+
+    free(line);
+    fclose(sock);
+    return status;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memmodel.h"
+
+void mem_default_config(mem_config *config) {
+    config->line_size = 1;
+    config->lines = 0;
+    config->ways = 0;
+    config->miss_penalty = 48;
+}
+
+bool mem_parse_config(const char *spec, mem_config *config, FILE *err) {
+    mem_config parsed = *config;
+    char *copy = strdup(spec);
+    char *save = NULL;
+    bool ok = true;
+
+    for (char *field = strtok_r(copy, ",", &save); field && ok; field = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(field, '=');
+        char *end = NULL;
+        unsigned long number = 0;
+        if (value) {
+            *value++ = '\0';
+            number = strtoul(value, &end, 10);
+        }
+        if (!value || *value == '\0' || *end != '\0' || number > 1000000 ||
+            (strcmp(field, "penalty") == 0 && number > MEM_MAX_PENALTY)) {
+            ok = false;
+        } else if (strcmp(field, "line") == 0) {
+            parsed.line_size = number;
+        } else if (strcmp(field, "lines") == 0) {
+            parsed.lines = number;
+        } else if (strcmp(field, "ways") == 0) {
+            parsed.ways = number;
+        } else if (strcmp(field, "penalty") == 0) {
+            parsed.miss_penalty = number;
+        } else {
+            ok = false;
+        }
+    }
+    free(copy);
+
+    /* Lines must be a power of two and the cache must fit local memory */
+    unsigned ways = parsed.ways ? parsed.ways : parsed.lines;
+    if (ok && (parsed.line_size == 0 || parsed.line_size > MEM_MAX_LINES ||
+               (parsed.line_size & (parsed.line_size - 1)) != 0 ||
+               parsed.lines > MEM_MAX_LINES ||
+               (parsed.lines && (ways == 0 || ways > parsed.lines || parsed.lines % ways != 0)))) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(err, "Error: bad memory configuration: %s\n", spec);
+        return false;
+    }
+    *config = parsed;
+    return true;
+}
+
+void mem_describe(FILE *out, const mem_config *config) {
+    fprintf(out, "line %u, ", config->line_size);
+    if (config->lines == 0) {
+        fprintf(out, "unlimited lines");
+    } else if (config->ways == 0 || config->ways == config->lines) {
+        fprintf(out, "%u lines fully associative", config->lines);
+    } else {
+        fprintf(out, "%u lines %u-way", config->lines, config->ways);
+    }
+    fprintf(out, ", miss penalty %u", config->miss_penalty);
+}
+
+void mem_cache_init(mem_cache *cache, const mem_config *config) {
+    memset(cache, 0, sizeof(*cache));
+    cache->config = *config;
+    while ((1U << cache->line_shift) < config->line_size) {
+        cache->line_shift++;
+    }
+    if (config->lines) {
+        cache->ways = config->ways ? config->ways : config->lines;
+        cache->sets = config->lines / cache->ways;
+    }
+}
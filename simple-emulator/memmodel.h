@@ -0,0 +1,82 @@
+#ifndef MEMMODEL_H
+#define MEMMODEL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Local memory is byte addressed with 8-bit addresses */
+#define MEM_MAX_LINES 256
+#define MEM_MAX_PENALTY 1000
+
+/*
+ * Local memory timing parameters. The defaults reproduce the original
+ * accounting: every byte misses once on first use and hits afterwards.
+ */
+typedef struct {
+    unsigned line_size;     /* bytes per line, a power of two */
+    unsigned lines;         /* capacity in lines, 0 for unlimited */
+    unsigned ways;          /* associativity, 0 for fully associative */
+    unsigned miss_penalty;  /* extra clock cycles on a miss */
+} mem_config;
+
+/* Cache state for one configuration */
+typedef struct {
+    mem_config config;
+    unsigned line_shift;
+    unsigned sets, ways;
+    unsigned clock;
+    unsigned hits, accesses;
+    bool present[MEM_MAX_LINES];            /* unlimited capacity: lines seen */
+    unsigned char tag[MEM_MAX_LINES];       /* set-major, ways per set */
+    bool valid[MEM_MAX_LINES];
+    unsigned age[MEM_MAX_LINES];            /* last use, for LRU replacement */
+} mem_cache;
+
+void mem_default_config(mem_config *config);
+
+/* Parse "line=N,lines=N,ways=N,penalty=N", unspecified fields keep their
+ * current value. Returns false and reports to err on a bad specification. */
+bool mem_parse_config(const char *spec, mem_config *config, FILE *err);
+
+void mem_describe(FILE *out, const mem_config *config);
+void mem_cache_init(mem_cache *cache, const mem_config *config);
+
+/* Clock cycles spent on memory for a number of accesses and hits */
+static inline unsigned mem_cycles(const mem_config *config, unsigned accesses, unsigned hits) {
+    return accesses + (accesses - hits) * config->miss_penalty;
+}
+
+/* Look up an address, filling the line on a miss. Returns true on a hit. */
+static inline bool mem_access(mem_cache *cache, unsigned char address) {
+    unsigned line = address >> cache->line_shift;
+    cache->accesses++;
+
+    if (cache->config.lines == 0) {
+        if (cache->present[line]) {
+            cache->hits++;
+            return true;
+        }
+        cache->present[line] = true;
+        return false;
+    }
+
+    unsigned base = (line % cache->sets) * cache->ways;
+    unsigned victim = base;
+    cache->clock++;
+    for (unsigned way = base; way < base + cache->ways; way++) {
+        if (cache->valid[way] && cache->tag[way] == line) {
+            cache->age[way] = cache->clock;
+            cache->hits++;
+            return true;
+        }
+        if (!cache->valid[way] || (cache->valid[victim] && cache->age[way] < cache->age[victim])) {
+            victim = way;
+        }
+    }
+    cache->valid[victim] = true;
+    cache->tag[victim] = line;
+    cache->age[victim] = cache->clock;
+    return false;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memmodel.h"
+#include "memtrace.h"
+
+/*
+ * Replays an LD/ST address stream recorded with 'myISS --record-mem' through
+ * the local memory timing model, once per configuration but in a single pass
+ * over the trace.
+ */
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: ./%s <trace.mtr> [-c line=N,lines=N,ways=N,penalty=N]...\n", name);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    /* Configurations, the default model when none are given */
+    int count = 0;
+    mem_cache *caches = calloc(argc, sizeof(*caches));
+    for (int i = 2; i < argc; i++) {
+        mem_config config;
+        mem_default_config(&config);
+        if (strcmp(argv[i], "-c") != 0 || i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (!mem_parse_config(argv[++i], &config, stderr)) {
+            return EXIT_FAILURE;
+        }
+        mem_cache_init(&caches[count++], &config);
+    }
+    if (count == 0) {
+        mem_config config;
+        mem_default_config(&config);
+        mem_cache_init(&caches[count++], &config);
+    }
+
+    mem_trace_reader reader;
+    if (!mem_trace_open(&reader, argv[1], stderr)) {
+        return EXIT_FAILURE;
+    }
+
+    /* Feed every access to every configuration */
+    unsigned char address;
+    bool store;
+    while (mem_trace_next(&reader, &address, &store)) {
+        for (int i = 0; i < count; i++) {
+            mem_access(&caches[i], address);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        const mem_cache *cache = &caches[i];
+        unsigned memory_cycles = mem_cycles(&cache->config, cache->accesses, cache->hits);
+        printf("Configuration: ");
+        mem_describe(stdout, &cache->config);
+        printf("\n");
+        printf("Number of hits to local memory: %u\n", cache->hits);
+        printf("Total number of executed LD/ST instructions: %u\n", cache->accesses);
+        printf("Total number of memory clock cycles: %u\n", memory_cycles);
+        printf("Total number of clock cycles: %u\n", reader.instruction_count + memory_cycles);
+    }
+
+    mem_trace_end(&reader);
+    free(caches);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "memtrace.h"
+
+#define TRACE_MAGIC "MTR1"
+#define TRACE_BUFFER (1 << 20)
+
+/* Token layout: zigzag distance << 2 | store << 1 | followed by a run count */
+
+static void put_varint(FILE *file, unsigned value) {
+    while (value >= 0x80) {
+        fputc((value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+static bool get_varint(FILE *file, unsigned *value) {
+    unsigned result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return false;
+        }
+        result |= (unsigned)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void put_u32(FILE *file, unsigned value) {
+    for (int i = 0; i < 4; i++) {
+        fputc((value >> (8 * i)) & 0xff, file);
+    }
+}
+
+bool mem_trace_create(mem_trace_writer *writer, const char *path, FILE *err) {
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(path, "wb");
+    if (!writer->file) {
+        fprintf(err, "Failed to open memory trace: %s\n", strerror(errno));
+        return false;
+    }
+    setvbuf(writer->file, NULL, _IOFBF, TRACE_BUFFER);
+    fputs(TRACE_MAGIC, writer->file);
+    put_u32(writer->file, 0);
+    return true;
+}
+
+static void flush_token(mem_trace_writer *writer) {
+    if (!writer->pending) {
+        return;
+    }
+    if (writer->repeat) {
+        put_varint(writer->file, writer->token | 1);
+        put_varint(writer->file, writer->repeat);
+    } else {
+        put_varint(writer->file, writer->token);
+    }
+    writer->pending = false;
+    writer->repeat = 0;
+}
+
+void mem_trace_record(mem_trace_writer *writer, unsigned char address, bool store) {
+    int distance = (int)address - writer->last;
+    unsigned zigzag = distance < 0 ? ((unsigned)-distance << 1) - 1 : (unsigned)distance << 1;
+    unsigned token = zigzag << 2 | (unsigned)store << 1;
+    writer->last = address;
+
+    if (writer->pending && token == writer->token) {
+        writer->repeat++;
+        return;
+    }
+    flush_token(writer);
+    writer->token = token;
+    writer->pending = true;
+}
+
+bool mem_trace_close(mem_trace_writer *writer, unsigned instruction_count) {
+    flush_token(writer);
+    bool ok = fseek(writer->file, strlen(TRACE_MAGIC), SEEK_SET) == 0;
+    if (ok) {
+        put_u32(writer->file, instruction_count);
+    }
+    ok = (fclose(writer->file) == 0) && ok;
+    writer->file = NULL;
+    return ok;
+}
+
+bool mem_trace_open(mem_trace_reader *reader, const char *path, FILE *err) {
+    char magic[4];
+    unsigned char count[4];
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+    if (!reader->file) {
+        fprintf(err, "Failed to open memory trace: %s\n", strerror(errno));
+        return false;
+    }
+    setvbuf(reader->file, NULL, _IOFBF, TRACE_BUFFER);
+    if (fread(magic, 1, 4, reader->file) != 4 || memcmp(magic, TRACE_MAGIC, 4) != 0 ||
+        fread(count, 1, 4, reader->file) != 4) {
+        fprintf(err, "Error: %s is not a memory trace\n", path);
+        fclose(reader->file);
+        reader->file = NULL;
+        return false;
+    }
+    reader->instruction_count = count[0] | count[1] << 8 | count[2] << 16 | (unsigned)count[3] << 24;
+    return true;
+}
+
+bool mem_trace_next(mem_trace_reader *reader, unsigned char *address, bool *store) {
+    if (reader->repeat) {
+        reader->repeat--;
+    } else {
+        if (!get_varint(reader->file, &reader->token)) {
+            return false;
+        }
+        if ((reader->token & 1) && !get_varint(reader->file, &reader->repeat)) {
+            return false;
+        }
+    }
+    unsigned zigzag = reader->token >> 2;
+    int distance = (zigzag & 1) ? -(int)((zigzag + 1) >> 1) : (int)(zigzag >> 1);
+    reader->last = (unsigned char)(reader->last + distance);
+    *address = reader->last;
+    *store = (reader->token >> 1) & 1;
+    return true;
+}
+
+void mem_trace_end(mem_trace_reader *reader) {
+    if (reader->file) {
+        fclose(reader->file);
+        reader->file = NULL;
+    }
+}
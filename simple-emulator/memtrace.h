@@ -0,0 +1,42 @@
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Compressed LD/ST address stream.
+ *
+ * The file starts with "MTR1" and the executed instruction count as a 32-bit
+ * little-endian value. Each access is stored as the signed distance from the
+ * previous address, zigzag encoded and tagged with a store bit, as a varint.
+ * An access repeating the previous distance and kind is folded into a run
+ * count, so strided loops shrink to a couple of bytes.
+ */
+typedef struct {
+    FILE *file;
+    unsigned char last;
+    unsigned token;     /* pending distance/kind token */
+    unsigned repeat;    /* further accesses with the same token */
+    bool pending;
+} mem_trace_writer;
+
+typedef struct {
+    FILE *file;
+    unsigned char last;
+    unsigned token;
+    unsigned repeat;
+    unsigned instruction_count;
+} mem_trace_reader;
+
+bool mem_trace_create(mem_trace_writer *writer, const char *path, FILE *err);
+void mem_trace_record(mem_trace_writer *writer, unsigned char address, bool store);
+/* Flushes pending runs and stores the instruction count in the header */
+bool mem_trace_close(mem_trace_writer *writer, unsigned instruction_count);
+
+bool mem_trace_open(mem_trace_reader *reader, const char *path, FILE *err);
+/* Returns false at the end of the trace */
+bool mem_trace_next(mem_trace_reader *reader, unsigned char *address, bool *store);
+void mem_trace_end(mem_trace_reader *reader);
+
+#endif
@@ -1,198 +1,175 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdbool.h>
-#include <math.h>
 #include <string.h>
-
-#define MEMORY_SIZE 256
-#define REGISTER_COUNT 6
-
-/* Memory data */
-char data[MEMORY_SIZE] = {0};
-bool initialized[MEMORY_SIZE] = {false};
-
-/* Register data */
-char registers[REGISTER_COUNT] = {0};
-bool equal_flag = false;
-
-/* Instruction data */
-char instruction[MEMORY_SIZE] = {-1};
-char arg1[MEMORY_SIZE] = {0};
-char arg2[MEMORY_SIZE] = {0};
-bool r_type[MEMORY_SIZE] = {false};
-
-int first_instruction = 0;
-
-/* Statistics */
-unsigned instruction_count = 0;
-unsigned cycle_count = 0;
-unsigned cache_hits = 0;
-unsigned memory_ops = 0;
-
-int main(int argc, char *argv[]) {
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read;
-
-    /* Check for argument */
-    if (argc != 2) {
-        fprintf(stderr, "Usage: ./%s <file.assembly>\n", argv[0]);
-        return EXIT_FAILURE;
-    }
-    
-    
-    /* Open file */
-    FILE *file = fopen(argv[1], "r");
+#include <time.h>
+#include "iss.h"
+
+/* Timed rounds per level in --bench, the median is reported */
+#define BENCH_ROUNDS 9
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: ./%s [options] <file.assembly>\n", name);
+    fprintf(stderr, "       ./%s --serve <socket> [--workers N] [--cache N]\n", name);
+    fprintf(stderr, "       ./%s --client <socket> [options] <file.assembly | ->\n", name);
+    fprintf(stderr, "       ./%s --bench N <file.assembly>\n", name);
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  --level L          instrumentation: functional, stats (default) or trace\n");
+    fprintf(stderr, "  --trace FILE       write a per-instruction trace, implies --level trace\n");
+    fprintf(stderr, "  --mem SPEC         local memory: line=N,lines=N,ways=N,penalty=N\n");
+    fprintf(stderr, "  --record-mem FILE  record the LD/ST address stream, implies --level trace\n");
+    fprintf(stderr, "  --max-instructions N  stop after N executed instructions\n");
+    fprintf(stderr, "  --max-cycles N     stop once N clock cycles have elapsed\n");
+    fprintf(stderr, "  --detect-loops     stop when the machine state repeats at a loop back-edge\n");
+    fprintf(stderr, "  --ooo              report timing on an out-of-order core\n");
+    fprintf(stderr, "  --issue-width N    out-of-order dispatch/issue/commit width (4)\n");
+    fprintf(stderr, "  --rob N            reorder buffer entries (64)\n");
+    fprintf(stderr, "  --lsq N            load/store queue entries (16)\n");
+    fprintf(stderr, "  --phys-regs N      physical registers (64)\n");
+}
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Time repeated runs of one program at every instrumentation level. Levels
+ * take turns within each round so drift hits them alike, and the median
+ * round is reported with the fastest and slowest next to it.
+ */
+static int bench(const char *path, unsigned runs) {
+    static const char *const names[] = { "functional", "stats", "trace" };
+    static iss_program program;
+    static iss_stats stats;
+    double times[ISS_LEVEL_TRACE + 1][BENCH_ROUNDS];
+
+    FILE *file = fopen(path, "r");
     if (!file) {
         perror("Failed to open file");
         return EXIT_FAILURE;
     }
+    iss_parse(file, &program, stdout);
+    fclose(file);
 
-    /* Read instruction data */
-    unsigned line_index = 0;
-    unsigned instruction_address = 0;
-    while ((read = getline(&line, &len, file)) != -1) {
-        /* Get instruction address*/
-        char *token = strtok(line, "\t ,[]\n");
-        if(token) {
-            instruction_address = atoi(token);
-            if (line_index == 0) {
-                first_instruction = instruction_address;
+    /* Faults would be reported once per run, kept in memory when there is
+     * no /dev/null to discard them */
+    char *discarded = NULL;
+    size_t discarded_len = 0;
+    FILE *err = fopen("/dev/null", "w");
+    if (!err) {
+        err = open_memstream(&discarded, &discarded_len);
+    }
+    if (!err) {
+        perror("Failed to open /dev/null");
+        return EXIT_FAILURE;
+    }
+    for (int round = -1; round < BENCH_ROUNDS; round++) {
+        for (int level = ISS_LEVEL_FUNCTIONAL; level <= ISS_LEVEL_TRACE; level++) {
+            iss_options options;
+            iss_default_options(&options);
+            options.level = level;
+
+            /* Round -1 only warms up */
+            double start = now();
+            for (unsigned i = 0; i < (round < 0 ? 1 : runs); i++) {
+                iss_run(&program, &options, &stats, err);
+            }
+            if (round >= 0) {
+                times[level][round] = (now() - start) * 1e9 / runs;
             }
-        } else {
-            printf("Error reading instruction address\n");
-            break;
         }
-
-        /* Get instruction */
-        token = strtok(NULL, "\t ,[]\n");
-        switch(token[0]) {
-            case 'M': // MOV
-                instruction[instruction_address] = 0;
-                break;
-            case 'A': // ADD
-                instruction[instruction_address] = 1;
-                break;
-            case 'C': // CMP
-                instruction[instruction_address] = 2;
-                r_type[instruction_address] = true;
-                break;
-            case 'J': // JE/JMP
-                if (token[1] == 'E') {
-                    instruction[instruction_address] = 3;
-                } else {
-                    instruction[instruction_address] = 4;
-                }
-                break;
-            case 'L': // LD
-                instruction[instruction_address] = 5;
-                r_type[instruction_address] = true;
-                break;
-            case 'S': // ST
-                instruction[instruction_address] = 6;
-                r_type[instruction_address] = true;
-                break;
-            default: // Invalid instruction
-                instruction[instruction_address] = -1;
-                break;
+    }
+    fclose(err);
+    free(discarded);
+
+    double base = 0;
+    printf("%-12s %12s %10s %23s\n", "Level", "ns/run", "Overhead", "Range over rounds");
+    for (int level = ISS_LEVEL_FUNCTIONAL; level <= ISS_LEVEL_TRACE; level++) {
+        qsort(times[level], BENCH_ROUNDS, sizeof(double), compare_doubles);
+        double median = times[level][BENCH_ROUNDS / 2];
+        if (level == ISS_LEVEL_FUNCTIONAL) {
+            base = median;
         }
+        printf("%-12s %12.1f %9.2fx %11.1f - %9.1f\n", names[level], median, median / base,
+               times[level][0], times[level][BENCH_ROUNDS - 1]);
+    }
+    return EXIT_SUCCESS;
+}
 
-        /* Get arguments */
-        token = strtok(NULL, "\t ,[]\n");
-        if (token) {
-            if (instruction[instruction_address] != 3 && instruction[instruction_address] != 4) {
-                    arg1[instruction_address] = atoi(&token[1]);
-            } else {
-                    arg1[instruction_address] = atoi(token);
-            }
-        } else {
-                printf("Error reading arg1\n");
-                break;
-        } 
-
-        if (instruction[instruction_address] != 3 && instruction[instruction_address] != 4) {
-            token = strtok(NULL, "\t ,[]\n");
-            if (token) {
-                if (token[0] == 'R') {
-                    arg2[instruction_address] = atoi(&token[1]);
-                    r_type[instruction_address] = true; 
-                } else {
-                    arg2[instruction_address] = atoi(token);
-                }
+int main(int argc, char *argv[]) {
+    /* Resident daemon */
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0) {
+        unsigned workers = 4;
+        unsigned cache_entries = 64;
+        for (int i = 3; i < argc; i++) {
+            if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+                workers = strtoul(argv[++i], NULL, 10);
+            } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+                cache_entries = strtoul(argv[++i], NULL, 10);
             } else {
-                printf("Error reading arg2\n");
-                break;
+                usage(argv[0]);
+                return EXIT_FAILURE;
             }
         }
+        if (workers == 0) {
+            workers = 1;
+        }
+        return iss_serve(argv[2], workers, cache_entries);
+    }
+
+    /* Instrumentation overhead benchmark */
+    if (argc == 4 && strcmp(argv[1], "--bench") == 0) {
+        unsigned runs = strtoul(argv[2], NULL, 10);
+        return bench(argv[3], runs ? runs : 1);
+    }
 
-        line_index++;
+    /* Thin client, prints exactly what a local run would */
+    if (argc >= 4 && strcmp(argv[1], "--client") == 0) {
+        return iss_client(argv[2], argc - 3, &argv[3]);
     }
 
-    instruction_address = first_instruction;
-
-    /* Run simulation */
-    while (instruction[instruction_address] != -1) {
-        switch(instruction[instruction_address]) {
-            case 0: // MOV
-                registers[arg1[instruction_address] - 1] = arg2[instruction_address];
-                break;
-            case 1: // ADD
-                if (r_type[instruction_address])
-                    registers[arg1[instruction_address] - 1] += registers[arg2[instruction_address] - 1];
-                else
-                    registers[arg1[instruction_address] - 1] += arg2[instruction_address];
-                break;
-            case 2: // CMP
-                equal_flag = (registers[arg1[instruction_address] - 1] == registers[arg2[instruction_address] - 1]);
-                break;
-            case 3: // JE
-                if (equal_flag) {
-                    instruction_address = arg1[instruction_address] - 1;
-                    equal_flag = false;
-                }
-                break;
-            case 4: // JMP
-                instruction_address = arg1[instruction_address] - 1;
-                break;
-            case 5: // LD
-                if (!initialized[registers[arg2[instruction_address] - 1]]) {
-                    cycle_count += 48;
-                    data[registers[arg2[instruction_address] - 1]] = 0;
-                    initialized[registers[arg2[instruction_address] - 1]] = true;
-                } else {
-                    cache_hits++;
-                }
-                registers[arg1[instruction_address] - 1] = data[registers[arg2[instruction_address] - 1]];
-                cycle_count += 1;
-                memory_ops++;
-                break;
-            case 6: // ST
-                if (!initialized[registers[arg1[instruction_address] - 1]]) {
-                    cycle_count += 48;
-                    initialized[registers[arg1[instruction_address] - 1]] = true;
-                } else {
-                    cache_hits++;
-                }
-                data[registers[arg1[instruction_address] - 1]] = registers[arg2[instruction_address] - 1];
-                cycle_count += 1;
-                memory_ops++;
-                break;
-            default: // Invalid instruction
-                fprintf(stderr, "Error: Invalid instruction at index %d\n", instruction_address);
-                instruction_address = -1;
-                break;
+    /* Run options followed by the program */
+    iss_options options;
+    iss_default_options(&options);
+    int index = 1;
+    while (index < argc - 1) {
+        int used = iss_parse_option(&options, argc, argv, index, stderr);
+        if (used <= 0) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
         }
-        cycle_count += 1;
-        instruction_address++;
-        instruction_count++;
+        index += used;
+    }
+
+    /* Check for argument */
+    if (index != argc - 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
     }
 
-    printf("Total number of executed instructions: %u\n", instruction_count);
-    printf("Total number of clock cycles: %u\n", cycle_count);
-    printf("Number of hits to local memory: %u\n", cache_hits);
-    printf("Total number of executed LD/ST instructions: %u\n", memory_ops);
+    /* Open file */
+    FILE *file = fopen(argv[index], "r");
+    if (!file) {
+        perror("Failed to open file");
+        return EXIT_FAILURE;
+    }
 
+    /* Decode and run */
+    static iss_program program;
+    iss_stats stats;
+    iss_parse(file, &program, stdout);
     fclose(file);
+    if (!iss_run(&program, &options, &stats, stderr)) {
+        return EXIT_FAILURE;
+    }
+    iss_print_stats(stdout, &options, &stats);
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    /* Runs cut short by a budget or the loop detector report failure */
+    return stats.stop == ISS_HALTED ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "iss.h"
+#include "ooo.h"
+
+/*
+ * Out-of-order superscalar timing model.
+ *
+ * The functional core hands over every retired instruction in program order
+ * and the model works out when it would dispatch, issue, complete and commit
+ * on a core with the configured width, reorder buffer, load/store queue and
+ * physical register file. Branch outcomes come from the functional stream,
+ * so branches are treated as perfectly predicted. Latencies follow the
+ * in-order accounting: 1 cycle for ALU operations and branches, 2 for a
+ * local memory hit plus the memory model's miss penalty for a miss.
+ */
+
+#define ARCH_REGS (REGISTER_COUNT + 2) /* R0..R6 and the equal flag */
+#define FLAG_REG (REGISTER_COUNT + 1)
+#define SLOT_RING (1U << 16)
+#define ALU_LATENCY 1
+#define HIT_LATENCY 2
+
+struct ooo_model {
+    ooo_config config;
+    ooo_stats stats;
+
+    /* Commit cycles of the most recent ROB and LSQ occupants */
+    unsigned long long *rob_commit;
+    unsigned long long *lsq_commit;
+    unsigned long long memory_count;
+    unsigned long long oldest;
+
+    /* Front end and retirement progress */
+    unsigned long long dispatch_cycle, commit_cycle;
+    unsigned dispatch_used, commit_used;
+
+    /* Issue slots in use per cycle, tagged with the cycle they belong to */
+    unsigned long long *slot_cycle;
+    unsigned *slot_used;
+
+    /* Renaming: when each architectural register's value becomes ready and
+     * a min-heap of cycles at which physical registers return to the pool */
+    unsigned long long reg_ready[ARCH_REGS];
+    unsigned long long allocated, released;
+    unsigned long long *releases;
+    size_t release_count, release_capacity;
+
+    /* Completion cycle of the last store to each address, for forwarding */
+    unsigned long long store_ready[MEMORY_SIZE];
+};
+
+void ooo_default_config(ooo_config *config) {
+    config->issue_width = 4;
+    config->rob_size = 64;
+    config->lsq_size = 16;
+    config->phys_regs = 64;
+    config->miss_penalty = 48;
+}
+
+ooo_model *ooo_create(const ooo_config *config, FILE *err) {
+    if (config->issue_width == 0 || config->rob_size == 0 || config->lsq_size == 0) {
+        fprintf(err, "Error: issue width, ROB and LSQ sizes must be positive\n");
+        return NULL;
+    }
+    if (config->rob_size > OOO_MAX_ROB) {
+        fprintf(err, "Error: ROB size is limited to %u entries\n", OOO_MAX_ROB);
+        return NULL;
+    }
+    if (config->phys_regs <= ARCH_REGS) {
+        fprintf(err, "Error: need more than %d physical registers\n", ARCH_REGS);
+        return NULL;
+    }
+
+    ooo_model *model = calloc(1, sizeof(*model));
+    model->config = *config;
+    model->rob_commit = calloc(config->rob_size, sizeof(*model->rob_commit));
+    model->lsq_commit = calloc(config->lsq_size, sizeof(*model->lsq_commit));
+    model->slot_cycle = malloc(SLOT_RING * sizeof(*model->slot_cycle));
+    model->slot_used = calloc(SLOT_RING, sizeof(*model->slot_used));
+    memset(model->slot_cycle, 0xff, SLOT_RING * sizeof(*model->slot_cycle));
+    return model;
+}
+
+void ooo_destroy(ooo_model *model) {
+    if (!model) {
+        return;
+    }
+    free(model->rob_commit);
+    free(model->lsq_commit);
+    free(model->slot_cycle);
+    free(model->slot_used);
+    free(model->releases);
+    free(model);
+}
+
+static void release_push(ooo_model *model, unsigned long long cycle) {
+    if (model->release_count == model->release_capacity) {
+        model->release_capacity = model->release_capacity ? model->release_capacity * 2 : 64;
+        model->releases = realloc(model->releases, model->release_capacity * sizeof(*model->releases));
+    }
+    size_t i = model->release_count++;
+    while (i > 0 && model->releases[(i - 1) / 2] > cycle) {
+        model->releases[i] = model->releases[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    model->releases[i] = cycle;
+}
+
+static unsigned long long release_pop(ooo_model *model) {
+    unsigned long long top = model->releases[0];
+    unsigned long long last = model->releases[--model->release_count];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= model->release_count) break;
+        if (child + 1 < model->release_count && model->releases[child + 1] < model->releases[child]) child++;
+        if (model->releases[child] >= last) break;
+        model->releases[i] = model->releases[child];
+        i = child;
+    }
+    if (model->release_count > 0) {
+        model->releases[i] = last;
+    }
+    return top;
+}
+
+/* Earliest cycle at or after t where renaming can allocate count registers */
+static unsigned long long rename_cycle(ooo_model *model, unsigned long long t, unsigned count) {
+    unsigned long long spare = model->config.phys_regs - ARCH_REGS;
+    while (model->release_count > 0 && model->releases[0] < t) {
+        release_pop(model);
+        model->released++;
+    }
+    while (spare + model->released < model->allocated + count) {
+        unsigned long long freed = release_pop(model) + 1;
+        model->released++;
+        if (freed > t) t = freed;
+    }
+    model->allocated += count;
+    return t;
+}
+
+static unsigned long long max_cycle(unsigned long long a, unsigned long long b) {
+    return a > b ? a : b;
+}
+
+void ooo_step(ooo_model *model, const ooo_event *event) {
+    const unsigned width = model->config.issue_width;
+    const unsigned rob_size = model->config.rob_size;
+    const unsigned lsq_size = model->config.lsq_size;
+    unsigned long long n = model->stats.instructions++;
+    unsigned renames = (event->dest >= 0) + event->flag_write;
+
+    /* Dispatch in order, limited by width and free ROB, LSQ and registers */
+    unsigned long long t = model->dispatch_cycle;
+    if (model->dispatch_used == width) {
+        t++;
+    }
+    unsigned long long start = t;
+    if (n >= rob_size) {
+        t = max_cycle(t, model->rob_commit[n % rob_size] + 1);
+    }
+    model->stats.stall_rob += t - start;
+    start = t;
+    if (event->memory && model->memory_count >= lsq_size) {
+        t = max_cycle(t, model->lsq_commit[model->memory_count % lsq_size] + 1);
+    }
+    model->stats.stall_lsq += t - start;
+    start = t;
+    if (renames) {
+        t = rename_cycle(model, t, renames);
+    }
+    model->stats.stall_rename += t - start;
+    if (t != model->dispatch_cycle) {
+        model->dispatch_cycle = t;
+        model->dispatch_used = 0;
+    }
+    model->dispatch_used++;
+
+    /* Wait for operands, then for a free issue slot */
+    unsigned long long operands = 0;
+    if (event->src1 >= 0) operands = max_cycle(operands, model->reg_ready[(int)event->src1]);
+    if (event->src2 >= 0) operands = max_cycle(operands, model->reg_ready[(int)event->src2]);
+    if (event->flag_read) operands = max_cycle(operands, model->reg_ready[FLAG_REG]);
+    if (event->opcode == OP_LD) operands = max_cycle(operands, model->store_ready[event->address]);
+    unsigned long long ready = t + 1;
+    if (operands > ready) {
+        model->stats.wait_operands += operands - ready;
+        ready = operands;
+    }
+    unsigned long long issue = ready;
+    for (;;) {
+        unsigned slot = issue % SLOT_RING;
+        if (model->slot_cycle[slot] != issue) {
+            model->slot_cycle[slot] = issue;
+            model->slot_used[slot] = 0;
+        }
+        if (model->slot_used[slot] < width) {
+            model->slot_used[slot]++;
+            break;
+        }
+        issue++;
+    }
+    model->stats.wait_issue += issue - ready;
+
+    unsigned latency = ALU_LATENCY;
+    if (event->memory) {
+        latency = HIT_LATENCY + (event->miss ? model->config.miss_penalty : 0);
+    }
+    unsigned long long complete = issue + latency;
+    if (event->dest >= 0) model->reg_ready[(int)event->dest] = complete;
+    if (event->flag_write) model->reg_ready[FLAG_REG] = complete;
+    if (event->opcode == OP_ST) model->store_ready[event->address] = complete;
+
+    /* Commit in order, limited by width */
+    unsigned long long commit = max_cycle(complete, model->commit_cycle);
+    if (commit == model->commit_cycle && model->commit_used == width) {
+        commit++;
+    }
+    if (commit != model->commit_cycle) {
+        model->commit_cycle = commit;
+        model->commit_used = 0;
+    }
+    model->commit_used++;
+
+    /* ROB occupancy seen by this instruction at dispatch and over its life */
+    if (n >= rob_size && model->oldest < n - rob_size + 1) {
+        model->oldest = n - rob_size + 1;
+    }
+    while (model->oldest < n && model->rob_commit[model->oldest % rob_size] < t) {
+        model->oldest++;
+    }
+    unsigned occupancy = (unsigned)(n - model->oldest + 1);
+    if (occupancy > model->stats.rob_peak) {
+        model->stats.rob_peak = occupancy;
+    }
+    model->stats.rob_occupancy_sum += commit - t + 1;
+
+    model->rob_commit[n % rob_size] = commit;
+    if (event->memory) {
+        model->lsq_commit[model->memory_count++ % lsq_size] = commit;
+    }
+
+    /* Each new mapping frees the previous one once it commits */
+    for (unsigned i = 0; i < renames; i++) {
+        release_push(model, commit);
+    }
+}
+
+void ooo_finish(ooo_model *model, ooo_stats *stats) {
+    *stats = model->stats;
+    stats->cycles = stats->instructions ? model->commit_cycle + 1 : 0;
+}
+
+void ooo_print_stats(FILE *out, const ooo_config *config, const ooo_stats *stats) {
+    double cycles = stats->cycles ? (double)stats->cycles : 1.0;
+    fprintf(out, "Out-of-order model: width %u, ROB %u, LSQ %u, %u physical registers\n",
+            config->issue_width, config->rob_size, config->lsq_size, config->phys_regs);
+    fprintf(out, "Out-of-order clock cycles: %llu\n", stats->cycles);
+    fprintf(out, "IPC: %.3f\n", stats->instructions / cycles);
+    fprintf(out, "Average ROB occupancy: %.2f (peak %u)\n", stats->rob_occupancy_sum / cycles, stats->rob_peak);
+    fprintf(out, "Dispatch stall cycles, ROB full: %llu\n", stats->stall_rob);
+    fprintf(out, "Dispatch stall cycles, LSQ full: %llu\n", stats->stall_lsq);
+    fprintf(out, "Dispatch stall cycles, no free physical register: %llu\n", stats->stall_rename);
+    fprintf(out, "Issue wait cycles, operands not ready: %llu\n", stats->wait_operands);
+    fprintf(out, "Issue wait cycles, issue width: %llu\n", stats->wait_issue);
+}
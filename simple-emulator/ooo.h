@@ -0,0 +1,52 @@
+#ifndef OOO_H
+#define OOO_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Largest supported reorder buffer, keeps the issue slot ring unambiguous */
+#define OOO_MAX_ROB 1024
+
+/* Out-of-order core parameters */
+typedef struct {
+    unsigned issue_width;   /* dispatch, issue and commit width */
+    unsigned rob_size;      /* reorder buffer entries */
+    unsigned lsq_size;      /* load/store queue entries */
+    unsigned phys_regs;     /* physical registers backing R0..R6 and the flag */
+    unsigned miss_penalty;  /* extra latency of a local memory miss */
+} ooo_config;
+
+/* Results reported by the timing model */
+typedef struct {
+    unsigned long long instructions;
+    unsigned long long cycles;
+    unsigned long long rob_occupancy_sum;
+    unsigned rob_peak;
+    unsigned long long stall_rob;
+    unsigned long long stall_lsq;
+    unsigned long long stall_rename;
+    unsigned long long wait_operands;
+    unsigned long long wait_issue;
+} ooo_stats;
+
+/* Retired instruction handed from the functional core to the timing model */
+typedef struct {
+    char opcode;
+    signed char dest;       /* destination register, -1 if none */
+    signed char src1, src2; /* source registers, -1 if none */
+    bool flag_read, flag_write;
+    bool memory, miss;
+    unsigned char address;  /* LD/ST address */
+} ooo_event;
+
+typedef struct ooo_model ooo_model;
+
+void ooo_default_config(ooo_config *config);
+/* Returns NULL and reports to err if the configuration is unusable */
+ooo_model *ooo_create(const ooo_config *config, FILE *err);
+void ooo_step(ooo_model *model, const ooo_event *event);
+void ooo_finish(ooo_model *model, ooo_stats *stats);
+void ooo_destroy(ooo_model *model);
+void ooo_print_stats(FILE *out, const ooo_config *config, const ooo_stats *stats);
+
+#endif